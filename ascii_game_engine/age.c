@@ -47,6 +47,10 @@ static bl _register_apis(mb_interpreter_t* s) {
 	mb_register_func(s, "REG_KEY", age_api_reg_key_code);
 	mb_register_func(s, "SET_FRAME_RATE", age_api_set_frame_rate);
 	mb_register_func(s, "CREATE_SPRITE", age_api_create_sprite);
+	mb_register_func(s, "CREATE_SPRITE_FROM_ASSET", age_api_create_sprite_from_asset);
+	mb_register_func(s, "COMPILE_SPRITE_ASSET", age_api_compile_sprite_asset);
+	mb_register_func(s, "LOAD_SPRITES", age_api_load_sprites);
+	mb_register_func(s, "LOAD_SPRITES_ASYNC", age_api_load_sprites_async);
 	mb_register_func(s, "DESTROY_SPRITE", age_api_destroy_sprite);
 	mb_register_func(s, "DESTROY_ALL_SPRITES", age_api_destroy_all_sprites);
 	mb_register_func(s, "SET_SPRITE_POS", age_api_set_sprite_position);
@@ -109,7 +113,7 @@ World* create_world(void) {
 	result = AGE_MALLOC(World);
 	result->audio = create_sound_context();
 	result->input = create_input_context();
-	result->canvas = create_canvas(ST_DEFAULT_CANVAS_NAME);
+	result->canvas = create_canvas(ST_DEFAULT_CANVAS_NAME, CANVAS_WIDTH, CANVAS_HEIGHT);
 	set_cursor_visible(result->canvas, FALSE);
 
 	mb_init();
@@ -135,6 +139,7 @@ void destroy_world(void) {
 	mb_dispose();
 
 	destroy_canvas(_gWorld->canvas);
+	evict_sprite_assets(TRUE);
 	destroy_input_context(_gWorld->input);
 	destroy_sound_context(_gWorld->audio);
 	AGE_FREE(_gWorld);
@@ -167,18 +172,25 @@ s32 run_world(void) {
 
 	_gWorld->running = TRUE;
 	while(_gWorld->running) {
+#if AGE_IMPL == AGE_IMPL_HEADLESS
+		/* run as fast as possible with a fixed time step */
+		elapsed = EXPECTED_FRAME_TIME;
+#else
 		now = age_tick_count();
 		elapsed = now - old;
 		old = now;
+#endif
 		update_sound(AGE_SND, elapsed);
 		update_canvas(AGE_CVS, elapsed);
 		collide_canvas(AGE_CVS, elapsed);
 		render_canvas(AGE_CVS, elapsed);
 		tidy_canvas(AGE_CVS, elapsed);
+#if AGE_IMPL != AGE_IMPL_HEADLESS
 		delay = EXPECTED_FRAME_TIME - (age_tick_count() - old);
 		if(delay > 0) {
 			age_sleep(delay);
 		}
+#endif
 	}
 
 	return result;
@@ -41,6 +41,7 @@
 #include "input/ageinput.h"
 #include "message/agemessage.h"
 #include "render/agerenderer.h"
+#include "render/agerecorder.h"
 #include "script/agescriptapi.h"
 #include "script/my_basic/my_basic.h"
 
@@ -54,11 +54,25 @@
 #ifndef AGE_IMPL_WIN32
 #	define AGE_IMPL_WIN32 1
 #endif
+#ifndef AGE_IMPL_HEADLESS
+#	define AGE_IMPL_HEADLESS 2
+#endif
 
 #ifndef AGE_IMPL
 #	define AGE_IMPL AGE_IMPL_CONSOLE
 #endif
 
+#ifndef AGE_VT_OUTPUT
+#	define AGE_VT_OUTPUT 1
+#endif
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#	define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+
+#ifndef AGE_PRESENTER_THREAD
+#	define AGE_PRESENTER_THREAD 0
+#endif
+
 #ifndef CANVAS_WIDTH
 #	define CANVAS_WIDTH 80
 #endif
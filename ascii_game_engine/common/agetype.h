@@ -62,4 +62,11 @@ typedef struct Size {
 	s32 h;
 } Size;
 
+typedef struct Rect {
+	s32 x;
+	s32 y;
+	s32 w;
+	s32 h;
+} Rect;
+
 #endif /* __AGE_TYPE_H__ */
@@ -133,6 +133,47 @@ Str freadall(const Str _file) {
 	return result;
 }
 
+Ptr map_file(const Str _file, s32* _size) {
+	Ptr result = 0;
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = 0;
+	s32 size = 0;
+
+	file = CreateFileA(_file, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if(file == INVALID_HANDLE_VALUE) {
+		goto _exit;
+	}
+	size = (s32)GetFileSize(file, 0);
+	if(size <= 0) {
+		goto _exit;
+	}
+	mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	if(!mapping) {
+		goto _exit;
+	}
+	/* the view keeps the mapping alive after both handles are closed */
+	result = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+_exit:
+	if(mapping) {
+		CloseHandle(mapping);
+	}
+	if(file != INVALID_HANDLE_VALUE) {
+		CloseHandle(file);
+	}
+	if(_size) {
+		*_size = result ? size : 0;
+	}
+
+	return result;
+}
+
+void unmap_file(Ptr _view) {
+	assert(_view);
+
+	UnmapViewOfFile(_view);
+}
+
 Str copy_string(const Str _str) {
 	Str result = 0;
 	s32 l = (s32)strlen(_str);
@@ -95,6 +95,20 @@ AGE_API s32 fskipln(FILE* _fp);
  * @return - content of the file
  */
 AGE_API Str freadall(const Str _file);
+/**
+ * @brief map a whole file into memory read only
+ *
+ * @param[in] _file - file name
+ * @param[out] _size - mapped size in bytes, could be 0 if not needed
+ * @return - mapped view of the file, or 0 if failed
+ */
+AGE_API Ptr map_file(const Str _file, s32* _size);
+/**
+ * @brief unmap a file view mapped by map_file
+ *
+ * @param[in] _view - mapped view
+ */
+AGE_API void unmap_file(Ptr _view);
 
 /**
  * @brief create a new string and copy the given content to it
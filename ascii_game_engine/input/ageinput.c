@@ -23,7 +23,9 @@
 ** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
-#if AGE_IMPL == AGE_IMPL_CONSOLE
+#include "../ageconfig.h"
+
+#if AGE_IMPL == AGE_IMPL_CONSOLE || AGE_IMPL == AGE_IMPL_HEADLESS
 
 #include "../common/ageutil.h"
 #include "../common/ageallocator.h"
@@ -64,6 +66,7 @@ void update_input_context(Ptr _ctx) {
 	s32 key = 0;
 
 	memset(ctx->keys, 0, sizeof(ctx->keys));
+#if AGE_IMPL == AGE_IMPL_CONSOLE
 	while(kbhit()) {
 		key = getch();
 		if(224 == key) {
@@ -71,6 +74,7 @@ void update_input_context(Ptr _ctx) {
 		}
 		ctx->keys[key] = TRUE;
 	}
+#endif
 }
 
 bl register_key_map(s32 _player, KeyIndex _keyIdx, s32 _keyCode) {
@@ -95,4 +99,4 @@ bl is_key_down(Ptr _ctx, s32 _player, KeyIndex _keyIdx) {
 	return result;
 }
 
-#endif /* AGE_IMPL == AGE_IMPL_CONSOLE */
+#endif /* AGE_IMPL == AGE_IMPL_CONSOLE || AGE_IMPL == AGE_IMPL_HEADLESS */
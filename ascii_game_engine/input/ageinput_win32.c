@@ -23,6 +23,8 @@
 ** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include "../ageconfig.h"
+
 #if AGE_IMPL == AGE_IMPL_WIN32
 
 #endif /* AGE_IMPL == AGE_IMPL_WIN32 */
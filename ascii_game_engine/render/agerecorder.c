@@ -0,0 +1,302 @@
+/*
+** This source file is part of AGE
+**
+** For the latest info, see http://code.google.com/p/ascii-game-engine/
+**
+** Copyright (c) 2011 Tony & Tony's Toy Game Development Team
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy of
+** this software and associated documentation files (the "Software"), to deal in
+** the Software without restriction, including without limitation the rights to
+** use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+** the Software, and to permit persons to whom the Software is furnished to do so,
+** subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+** FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+** COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+** IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "../common/ageallocator.h"
+#include "../common/ageutil.h"
+#include "agerecorder.h"
+
+static const s8 RECORDING_MAGIC[4] = { 'A', 'G', 'E', 'R' };
+static const s32 RECORDING_VERSION = 1;
+static const s32 RECORDING_FLAG_KEYFRAME = 1;
+static const u64 RECORDING_MAX_EDGE = 4096;
+
+static void _write_varint(FILE* _fp, u64 _val) {
+	while(_val >= 0x80) {
+		fputc((s32)((_val & 0x7F) | 0x80), _fp);
+		_val >>= 7;
+	}
+	fputc((s32)_val, _fp);
+}
+
+static bl _read_varint(FILE* _fp, u64* _val) {
+	bl result = TRUE;
+	s32 c = 0;
+	s32 shift = 0;
+
+	*_val = 0;
+	do {
+		c = fgetc(_fp);
+		if(c == EOF || shift >= 64) {
+			result = FALSE;
+
+			break;
+		}
+		*_val |= (u64)(c & 0x7F) << shift;
+		shift += 7;
+	} while(c & 0x80);
+
+	return result;
+}
+
+static bl _is_pixel_changed(const PresentedPixel* _old, const PresentedPixel* _new) {
+	return _old->shape != _new->shape || _old->color != _new->color;
+}
+
+static s32 _write_runs(Recorder* _rec, const PresentedPixel* _pixels, bl _key, bl _write) {
+	s32 result = 0;
+	s32 n = _rec->size.w * _rec->size.h;
+	s32 i = 0;
+	s32 b = 0;
+	s32 k = 0;
+	s32 last = 0;
+
+	while(i < n) {
+		if(!_key && !_is_pixel_changed(&_rec->last_pixels[i], &_pixels[i])) {
+			++i;
+
+			continue;
+		}
+		b = i;
+		while(i < n && (_key || _is_pixel_changed(&_rec->last_pixels[i], &_pixels[i]))) {
+			++i;
+		}
+		if(_write) {
+			_write_varint(_rec->fp, (u64)(b - last));
+			_write_varint(_rec->fp, (u64)(i - b));
+			for(k = b; k < i; ++k) {
+				fputc((u8)_pixels[k].shape, _rec->fp);
+				_write_varint(_rec->fp, (u64)_pixels[k].color);
+			}
+		}
+		last = i;
+		++result;
+	}
+
+	return result;
+}
+
+static bl _read_frame(Playback* _pb, PresentedPixel* _pixels) {
+	bl result = TRUE;
+	s32 n = _pb->size.w * _pb->size.h;
+	s32 pos = 0;
+	s32 flags = 0;
+	u64 elapsed = 0;
+	u64 count = 0;
+	u64 skip = 0;
+	u64 len = 0;
+	u64 col = 0;
+	u64 i = 0;
+	u64 k = 0;
+
+	flags = fgetc(_pb->fp);
+	if(flags == EOF || !_read_varint(_pb->fp, &elapsed) || !_read_varint(_pb->fp, &count) || elapsed > 0x7FFFFFFF) {
+		result = FALSE;
+		goto _exit;
+	}
+	for(i = 0; i < count; ++i) {
+		if(!_read_varint(_pb->fp, &skip) || !_read_varint(_pb->fp, &len)) {
+			result = FALSE;
+			goto _exit;
+		}
+		/* a run must stay inside the frame, compared in 64 bits as varints are untrusted */
+		if(skip > (u64)(n - pos) || len > (u64)(n - pos) - skip) {
+			result = FALSE;
+			goto _exit;
+		}
+		pos += (s32)skip;
+		for(k = 0; k < len; ++k) {
+			s32 s = fgetc(_pb->fp);
+			if(s == EOF || !_read_varint(_pb->fp, &col)) {
+				result = FALSE;
+				goto _exit;
+			}
+			if(_pixels) {
+				_pixels[pos].shape = (s8)s;
+				_pixels[pos].color = (Color)col;
+			}
+			++pos;
+		}
+	}
+	_pb->elapsed_time = (s32)elapsed;
+
+_exit:
+	return result;
+}
+
+Recorder* create_recorder(const Str _file, Canvas* _cvs, s32 _keyframeInterval) {
+	Recorder* result = 0;
+	FILE* fp = 0;
+	s32 w = 0;
+	s32 h = 0;
+
+	assert(_cvs);
+
+	w = _cvs->view_size.w;
+	h = _cvs->view_size.h;
+	fp = fopen(_file, "wb");
+	if(!fp) {
+		goto _exit;
+	}
+	result = AGE_MALLOC(Recorder);
+	result->fp = fp;
+	result->size.w = w;
+	result->size.h = h;
+	result->keyframe_interval = _keyframeInterval > 0 ? _keyframeInterval : DEFAULT_KEYFRAME_INTERVAL;
+	result->last_pixels = AGE_MALLOC_N(PresentedPixel, w * h);
+
+	fwrite(RECORDING_MAGIC, 1, sizeof(RECORDING_MAGIC), fp);
+	fputc(RECORDING_VERSION, fp);
+	_write_varint(fp, (u64)w);
+	_write_varint(fp, (u64)h);
+	_write_varint(fp, (u64)result->keyframe_interval);
+
+_exit:
+	return result;
+}
+
+void destroy_recorder(Recorder* _rec) {
+	assert(_rec);
+
+	fclose(_rec->fp);
+	AGE_FREE_N(_rec->last_pixels);
+	AGE_FREE(_rec);
+}
+
+void record_frame(Recorder* _rec, const PresentedPixel* _pixels, s32 _elapsedTime) {
+	bl key = FALSE;
+
+	assert(_rec && _pixels);
+
+	key = _rec->frame_count % _rec->keyframe_interval == 0;
+	fputc(key ? RECORDING_FLAG_KEYFRAME : 0, _rec->fp);
+	_write_varint(_rec->fp, (u64)(_elapsedTime > 0 ? _elapsedTime : 0));
+	_write_varint(_rec->fp, (u64)_write_runs(_rec, _pixels, key, FALSE));
+	_write_runs(_rec, _pixels, key, TRUE);
+	memcpy(_rec->last_pixels, _pixels, sizeof(PresentedPixel) * _rec->size.w * _rec->size.h);
+	++_rec->frame_count;
+}
+
+Playback* create_playback(const Str _file) {
+	Playback* result = 0;
+	FILE* fp = 0;
+	s8 magic[sizeof(RECORDING_MAGIC)];
+	u64 w = 0;
+	u64 h = 0;
+	u64 itv = 0;
+	long offset = 0;
+	s32 flags = 0;
+
+	fp = fopen(_file, "rb");
+	if(!fp) {
+		goto _exit;
+	}
+	if(fread(magic, 1, sizeof(magic), fp) != sizeof(magic) || memcmp(magic, RECORDING_MAGIC, sizeof(magic)) ||
+		fgetc(fp) != RECORDING_VERSION ||
+		!_read_varint(fp, &w) || !_read_varint(fp, &h) || !_read_varint(fp, &itv) ||
+		!w || !h || !itv || w > RECORDING_MAX_EDGE || h > RECORDING_MAX_EDGE || itv > 0x7FFFFFFF
+	) {
+		fclose(fp);
+		goto _exit;
+	}
+	result = AGE_MALLOC(Playback);
+	result->fp = fp;
+	result->size.w = (s32)w;
+	result->size.h = (s32)h;
+	result->keyframe_interval = (s32)itv;
+	result->pixels = AGE_MALLOC_N(PresentedPixel, (s32)(w * h));
+
+	/* index keyframes for seeking */
+	while(TRUE) {
+		offset = ftell(fp);
+		flags = fgetc(fp);
+		if(flags == EOF) {
+			break;
+		}
+		ungetc(flags, fp);
+		if(flags & RECORDING_FLAG_KEYFRAME) {
+			result->keyframe_offsets = AGE_REALLOC_N(long, result->keyframe_offsets, (result->keyframe_count + 1));
+			result->keyframe_offsets[result->keyframe_count++] = offset;
+		}
+		if(!_read_frame(result, 0)) {
+			break;
+		}
+		++result->frame_count;
+	}
+	if(result->keyframe_count) {
+		fseek(fp, result->keyframe_offsets[0], SEEK_SET);
+	}
+
+_exit:
+	return result;
+}
+
+void destroy_playback(Playback* _pb) {
+	assert(_pb);
+
+	fclose(_pb->fp);
+	if(_pb->keyframe_offsets) {
+		AGE_FREE_N(_pb->keyframe_offsets);
+	}
+	AGE_FREE_N(_pb->pixels);
+	AGE_FREE(_pb);
+}
+
+bl read_playback_frame(Playback* _pb) {
+	bl result = FALSE;
+
+	assert(_pb);
+
+	if(_pb->current_frame < _pb->frame_count) {
+		result = _read_frame(_pb, _pb->pixels);
+		if(result) {
+			++_pb->current_frame;
+		}
+	}
+
+	return result;
+}
+
+bl seek_playback(Playback* _pb, s32 _frame) {
+	bl result = FALSE;
+	s32 k = 0;
+
+	assert(_pb);
+
+	if(_frame < 0 || _frame >= _pb->frame_count) {
+		goto _exit;
+	}
+	k = _frame / _pb->keyframe_interval;
+	if(k >= _pb->keyframe_count) {
+		goto _exit;
+	}
+	fseek(_pb->fp, _pb->keyframe_offsets[k], SEEK_SET);
+	_pb->current_frame = k * _pb->keyframe_interval;
+	do {
+		result = read_playback_frame(_pb);
+	} while(result && _pb->current_frame <= _frame);
+
+_exit:
+	return result;
+}
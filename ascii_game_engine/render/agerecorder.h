@@ -0,0 +1,123 @@
+/*
+** This source file is part of AGE
+**
+** For the latest info, see http://code.google.com/p/ascii-game-engine/
+**
+** Copyright (c) 2011 Tony & Tony's Toy Game Development Team
+**
+** Permission is hereby granted, free of charge, to any person obtaining a copy of
+** this software and associated documentation files (the "Software"), to deal in
+** the Software without restriction, including without limitation the rights to
+** use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+** the Software, and to permit persons to whom the Software is furnished to do so,
+** subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in all
+** copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+** FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+** COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+** IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef __AGE_RECORDER_H__
+#define __AGE_RECORDER_H__
+
+#include "../ageconfig.h"
+#include "../common/agetype.h"
+#include "agerenderer.h"
+
+/**
+ * @brief default keyframe interval of a recording, in frames
+ */
+static const s32 DEFAULT_KEYFRAME_INTERVAL = 100;
+
+/**
+ * @brief recorder structure, writes presented frames as deltas into a binary stream
+ *
+ * @note stream layout, all integers are unsigned LEB128 varints:
+ *       header : "AGER", version byte, width, height, keyframe interval
+ *       frame  : flags byte (1 for keyframe), elapsed time, runs count, runs
+ *       run    : skipped pixels count since last run, pixels count, pixels
+ *       pixel  : shape byte, color
+ */
+typedef struct Recorder {
+	FILE* fp;                    /**< output file */
+	Size size;                   /**< frame size */
+	s32 keyframe_interval;       /**< a keyframe is written every this many frames */
+	s32 frame_count;             /**< recorded frames count */
+	PresentedPixel* last_pixels; /**< pixels of last recorded frame */
+} Recorder;
+
+/**
+ * @brief playback structure, reads a stream written by a recorder
+ */
+typedef struct Playback {
+	FILE* fp;                /**< input file */
+	Size size;               /**< frame size */
+	s32 keyframe_interval;   /**< keyframe interval */
+	s32 frame_count;         /**< frames count */
+	s32 current_frame;       /**< index of next frame to be read */
+	s32 elapsed_time;        /**< elapsed time of last read frame */
+	long* keyframe_offsets;  /**< stream offsets of keyframes */
+	s32 keyframe_count;      /**< keyframes count */
+	PresentedPixel* pixels;  /**< pixels of last read frame */
+} Playback;
+
+/**
+ * @brief create a recorder object
+ *
+ * @param[in] _file              - output file name
+ * @param[in] _cvs               - canvas object to be recorded, frames are sized as its viewport
+ * @param[in] _keyframeInterval  - a keyframe is written every this many frames
+ * @return - created recorder object, or 0 if failed
+ */
+AGE_API Recorder* create_recorder(const Str _file, Canvas* _cvs, s32 _keyframeInterval);
+/**
+ * @brief destroy a recorder object
+ *
+ * @param[in] _rec - recorder object
+ */
+AGE_API void destroy_recorder(Recorder* _rec);
+/**
+ * @brief record a frame
+ *
+ * @param[in] _rec         - recorder object
+ * @param[in] _pixels      - pixels of the frame
+ * @param[in] _elapsedTime - elapsed time since last frame
+ */
+AGE_API void record_frame(Recorder* _rec, const PresentedPixel* _pixels, s32 _elapsedTime);
+
+/**
+ * @brief create a playback object
+ *
+ * @param[in] _file - input file name
+ * @return - created playback object, or 0 if failed
+ */
+AGE_API Playback* create_playback(const Str _file);
+/**
+ * @brief destroy a playback object
+ *
+ * @param[in] _pb - playback object
+ */
+AGE_API void destroy_playback(Playback* _pb);
+/**
+ * @brief read next frame of a playback into its pixels
+ *
+ * @param[in] _pb - playback object
+ * @return - return TRUE if succeed, or FALSE if no more frames
+ */
+AGE_API bl read_playback_frame(Playback* _pb);
+/**
+ * @brief seek a playback, the given frame will be the last read frame
+ *
+ * @param[in] _pb    - playback object
+ * @param[in] _frame - frame index
+ * @return - return TRUE if succeed, or FALSE if failed
+ */
+AGE_API bl seek_playback(Playback* _pb, s32 _frame);
+
+#endif /* __AGE_RECORDER_H__ */
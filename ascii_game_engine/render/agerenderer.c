@@ -23,12 +23,15 @@
 ** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
-#if AGE_IMPL == AGE_IMPL_CONSOLE
+#include "../ageconfig.h"
+
+#if AGE_IMPL == AGE_IMPL_CONSOLE || AGE_IMPL == AGE_IMPL_HEADLESS
 
 #include "../common/ageallocator.h"
 #include "../common/ageutil.h"
 #include "../common/agestringtable.h"
 #include "agerenderer.h"
+#include "agerecorder.h"
 
 static const Color COLOR_MAP[] = {
 	0,   1,   2,   3,   4,   5,   6,   7,
@@ -37,612 +40,3553 @@ static const Color COLOR_MAP[] = {
 
 static Sprite* tobeRemoved = 0;
 
-static void _destroy_sprite_impl(Canvas* _cvs, Sprite* _spr) {
-	s32 k = 0;
+static ht_node_t* copyingNamedFrames = 0;
+
+static ht_node_t* assetCache = 0;
+static SpriteAssetStats assetStats;
+static Str* evictingKeys = 0;
+static s32 evictingCount = 0;
+static bl evictingAll = FALSE;
+
+typedef struct AssetLoadingJob {
+	Str sprite_name;
+	Str shape_file;
+	Str brush_file;
+	Str palete_file;
+	Str key;
+	FrameSet* frame_set;
+	bl skipped;
+	volatile LONG loaded;
+} AssetLoadingJob;
+
+typedef struct AssetLoading {
+	struct AssetLoading* next;
+	AssetLoadingJob* jobs;
+	s32 job_count;
+	s32 published_count;
+	volatile LONG next_job;
+	volatile LONG cancelled;
+	HANDLE* workers;
+	s32 worker_count;
+	HANDLE event;
+	asset_loaded_callback_func loaded;
+	bl detached;
+	bl destroyed;
+} AssetLoading;
+
+typedef struct OwnerChunk {
+	struct OwnerChunk* next;
+	s32 size;
+	s32 used;
+	PixelOwner* owners;
+} OwnerChunk;
+
+static const s32 OWNER_CHUNK_SIZE = 4096;
+
+static const u8 XTERM_CUBE_LEVELS[] = { 0, 95, 135, 175, 215, 255 };
+
+static const s32 FRAME_ATLAS_ALIGNMENT = 16;
+
+static const s8 COMPILED_ASSET_MAGIC[4] = { 'A', 'G', 'E', 'S' };
+static const s32 COMPILED_ASSET_VERSION = 2;
+static const s32 COMPILED_ASSET_HEADER_SIZE = 56;
+static const s32 COMPILED_FRAME_SIZE = 24;
+static const s32 COMPILED_TEXEL_SIZE = 8;
+static const s32 COMPILED_SPAN_SIZE = 12;
+
+static FILE* compilingAssetFile = 0;
+static s32 compilingNameCount = 0;
+
+/* compiled asset file layout, every field is a little endian 32-bit value, a texel is a color,
+   a shape, a brush and two zero bytes; texels and spans sections are aligned like a frame set
+   so that a mapped file is used in place on a host with the same texel and span layout */
+typedef struct CompiledAssetHeader {
+	s8 magic[4];
+	s32 version;
+	s32 texel_size;
+	s32 span_size;
+	s32 frame_count;
+	s32 width;
+	s32 height;
+	f32 frame_rate;
+	s32 frames_offset;
+	s32 texels_offset;
+	s32 spans_offset;
+	s32 span_count;
+	s32 names_offset;
+	s32 name_count;
+} CompiledAssetHeader;
+
+typedef struct CompiledFrame {
+	s32 draw_first;
+	s32 draw_count;
+	s32 erase_first;
+	s32 erase_count;
+	s32 collide_first;
+	s32 collide_count;
+} CompiledFrame;
+
+static u32 _swap_red_blue(u32 _col) {
+	/* console attributes order color bits as BGR, color indices as RGB */
+	return ((_col & 1) << 2) | (_col & 2) | ((_col & 4) >> 2);
+}
 
-	destroy_sprite_message_map(_spr);
-	if(_spr->time_line.shape_file_name) {
-		AGE_FREE(_spr->time_line.shape_file_name);
-	}
-	if(_spr->time_line.brush_file_name) {
-		AGE_FREE(_spr->time_line.brush_file_name);
-	}
-	if(_spr->time_line.palete_file_name) {
-		AGE_FREE(_spr->time_line.palete_file_name);
-	}
-	for(k = 0; k < _spr->time_line.frame_count; ++k) {
-		AGE_FREE_N(_spr->time_line.frames[k].tex);
-	}
-	AGE_FREE_N(_spr->time_line.frames);
-	ht_destroy(_spr->time_line.named_frames);
-	if(_spr->time_line.begin_name) {
-		AGE_FREE(_spr->time_line.begin_name);
-	}
-	if(_spr->time_line.end_name) {
-		AGE_FREE(_spr->time_line.end_name);
-	}
-	if(_spr->userdata.destroy) {
-		assert(_spr->userdata.data);
-		_spr->userdata.destroy(_spr->userdata.data);
+static const u32 CONSOLE_COLOR_RGB[] = {
+	0x000000, 0x800000, 0x008000, 0x808000, 0x000080, 0x800080, 0x008080, 0xC0C0C0,
+	0x808080, 0xFF0000, 0x00FF00, 0xFFFF00, 0x0000FF, 0xFF00FF, 0x00FFFF, 0xFFFFFF,
+};
+
+static u32 _channel_rgb(u32 _ch) {
+	u32 result = 0;
+	u32 i = 0;
+
+	if(_ch & COLOR_CHANNEL_RGB) {
+		result = _ch & 0xFFFFFF;
+	} else if(_ch < 16) {
+		result = CONSOLE_COLOR_RGB[_ch];
+	} else if(_ch < 232) {
+		i = _ch - 16;
+		result = ((u32)XTERM_CUBE_LEVELS[i / 36] << 16) | ((u32)XTERM_CUBE_LEVELS[i / 6 % 6] << 8) | (u32)XTERM_CUBE_LEVELS[i % 6];
+	} else {
+		i = 8 + (_ch - 232) * 10;
+		result = (i << 16) | (i << 8) | i;
 	}
-	destroy_paramset(_spr->params);
-	AGE_FREE(_spr->name);
-	AGE_FREE(_spr);
-}
 
-static s32 _drop_sprite(Canvas* _cvs, Sprite* _spr) {
-	s32 result = 0;
+	return result;
+}
 
-	++_cvs->dropped_sprites_count;
-	if(_cvs->dropped_sprites_count > _cvs->dropped_sprites_size) {
-		_cvs->dropped_sprites_size = _cvs->dropped_sprites_count + 8;
-		_cvs->dropped_sprites = AGE_REALLOC_N(Sprite*, _cvs->dropped_sprites, _cvs->dropped_sprites_size);
+static u32 _nearest_console_color(u32 _ch) {
+	u32 result = 0;
+	u32 rgb = 0;
+	s32 d = 0;
+	s32 dr = 0;
+	s32 dg = 0;
+	s32 db = 0;
+	s32 best = 0x7FFFFFFF;
+	u32 i = 0;
+
+	if(!(_ch & COLOR_CHANNEL_RGB) && _ch < 16) {
+		result = _ch;
+	} else {
+		/* approximates others to the 16 console colors */
+		rgb = _channel_rgb(_ch);
+		for(i = 0; i < _countof(CONSOLE_COLOR_RGB); ++i) {
+			dr = (s32)((rgb >> 16) & 0xFF) - (s32)((CONSOLE_COLOR_RGB[i] >> 16) & 0xFF);
+			dg = (s32)((rgb >> 8) & 0xFF) - (s32)((CONSOLE_COLOR_RGB[i] >> 8) & 0xFF);
+			db = (s32)(rgb & 0xFF) - (s32)(CONSOLE_COLOR_RGB[i] & 0xFF);
+			d = dr * dr + dg * dg + db * db;
+			if(d < best) {
+				best = d;
+				result = i;
+			}
+		}
 	}
-	_cvs->dropped_sprites[_cvs->dropped_sprites_count - 1] = _spr;
 
 	return result;
 }
 
-static s32 _destroy_sprite(Ptr _data, Ptr _extra) {
-	s32 result = 0;
+#if AGE_IMPL == AGE_IMPL_HEADLESS
+typedef struct HeadlessTarget {
+	s8* shapes;
+	Color* colors;
+	u32 hash;
+} HeadlessTarget;
 
-	Sprite* spr = (Sprite*)_data;
-	_drop_sprite(spr->owner, spr);
+static u32 _hash_target_pixel(s32 _index, s8 _shape, Color _col) {
+	u32 result = ((u32)_index * 0x9E3779B1u) ^ ((u32)(u8)_shape | ((u32)_col << 8));
+
+	result ^= result >> 16;
+	result *= 0x85EBCA6Bu;
+	result ^= result >> 13;
+	result *= 0xC2B2AE35u;
+	result ^= result >> 16;
 
 	return result;
 }
 
-static s32 _on_removing_sprite(Ptr _data, Ptr _extra) {
-	s32 result = 0;
+static void _clear_target(Canvas* _cvs) {
+	HeadlessTarget* tgt = (HeadlessTarget*)_cvs->target;
+	s32 i = 0;
+	s32 n = _cvs->view_size.w * _cvs->view_size.h;
 
-	Sprite* spr = (Sprite*)_data;
-	if(spr != tobeRemoved) {
-		if(spr->object_removed) {
-			spr->object_removed(spr, tobeRemoved->owner, tobeRemoved);
-		}
+	tgt->hash = 0;
+	for(i = 0; i < n; ++i) {
+		tgt->shapes[i] = ERASE_PIXEL_SHAPE;
+		tgt->colors[i] = 0;
+		tgt->hash ^= _hash_target_pixel(i, ERASE_PIXEL_SHAPE, 0);
 	}
+}
 
-	return result;
+static void _open_output(Canvas* _cvs) {
+	HeadlessTarget* tgt = AGE_MALLOC(HeadlessTarget);
+	s32 n = _cvs->view_size.w * _cvs->view_size.h;
+
+	tgt->shapes = AGE_MALLOC_N(s8, n);
+	tgt->colors = AGE_MALLOC_N(Color, n);
+	_cvs->target = tgt;
+	_clear_target(_cvs);
+	_cvs->context.last_position.x = 0;
+	_cvs->context.last_position.y = 0;
 }
 
-static s32 _destroy_string(Ptr _data, Ptr _extra) {
-	s32 result = 0;
-	s32 k = 0;
+static void _close_output(Canvas* _cvs) {
+	HeadlessTarget* tgt = (HeadlessTarget*)_cvs->target;
 
-	Str fname = (Str)_extra;
-	AGE_FREE(fname);
+	AGE_FREE_N(tgt->shapes);
+	AGE_FREE_N(tgt->colors);
+	AGE_FREE(_cvs->target);
+}
 
-	return result;
+static void _flush_output(Canvas* _cvs) {
+	/* do nothing */
 }
 
-static s32 _update_sprite(Ptr _data, Ptr _extra) {
-	s32 result = 0;
+static void _clear_output(Canvas* _cvs) {
+	_clear_target(_cvs);
+	_cvs->context.last_position.x = 0;
+	_cvs->context.last_position.y = 0;
+}
 
-	Sprite* spr = (Sprite*)_data;
-	Canvas* cvs = (Canvas*)spr->owner;
-	if(spr->update) {
-		spr->update(cvs, spr, cvs->context.last_elapsed_time);
-	} else {
-		update_sprite(cvs, spr, cvs->context.last_elapsed_time);
+static void _output_char(Canvas* _cvs, s8 _ch) {
+	HeadlessTarget* tgt = (HeadlessTarget*)_cvs->target;
+	Point* pos = &_cvs->context.last_position;
+	s32 i = 0;
+
+	if(pos->x >= 0 && pos->x < _cvs->view_size.w && pos->y >= 0 && pos->y < _cvs->view_size.h) {
+		i = pos->x + pos->y * _cvs->view_size.w;
+		tgt->hash ^= _hash_target_pixel(i, tgt->shapes[i], tgt->colors[i]);
+		tgt->shapes[i] = _ch;
+		tgt->colors[i] = _cvs->context.last_color;
+		tgt->hash ^= _hash_target_pixel(i, _ch, _cvs->context.last_color);
 	}
-	if(spr->control) {
-		spr->control(
-			spr,
-			spr->name,
-			cvs->context.last_elapsed_time,
-			cvs->context.last_lparam,
-			cvs->context.last_wparam,
-			cvs->context.last_extra
-		);
+	if(++pos->x >= _cvs->view_size.w) {
+		pos->x = 0;
+		++pos->y;
 	}
+}
+#else
+static void _write_stream(Canvas* _cvs, const s8* _data, s32 _len) {
+	OutputStream* os = &_cvs->stream;
 
-	return result;
+	if(os->size + _len > os->capacity) {
+		os->capacity = (os->size + _len) * 2;
+		os->data = AGE_REALLOC_N(s8, os->data, os->capacity);
+	}
+	memcpy(os->data + os->size, _data, _len);
+	os->size += _len;
 }
 
-static s32 _fire_render_sprite(Ptr _data, Ptr _extra) {
-	s32 result = 0;
+static s32 _xterm_cube_level(u32 _val) {
+	s32 result = -1;
+	s32 i = 0;
 
-	Sprite* spr = (Sprite*)_data;
-	Canvas* cvs = (Canvas*)spr->owner;
-	if(spr->prev_render) {
-		spr->prev_render(cvs, spr, cvs->context.last_elapsed_time);
-	} else {
-		prev_render_sprite(cvs, spr, cvs->context.last_elapsed_time);
+	for(i = 0; i < _countof(XTERM_CUBE_LEVELS); ++i) {
+		if(XTERM_CUBE_LEVELS[i] == _val) {
+			result = i;
+
+			break;
+		}
 	}
 
 	return result;
 }
 
-static s32 _post_render_sprite(Ptr _data, Ptr _extra) {
-	s32 result = 0;
-
-	Sprite* spr = (Sprite*)_data;
-	Canvas* cvs = (Canvas*)spr->owner;
-	if(spr->post_render) {
-		spr->post_render(cvs, spr, cvs->context.last_elapsed_time);
-	} else {
-		post_render_sprite(cvs, spr, cvs->context.last_elapsed_time);
+static u32 _canonical_channel(u32 _ch) {
+	u32 result = _ch;
+	u32 r = (_ch >> 16) & 0xFF;
+	u32 g = (_ch >> 8) & 0xFF;
+	u32 b = _ch & 0xFF;
+	s32 ri = 0;
+	s32 gi = 0;
+	s32 bi = 0;
+
+	/* an RGB value that sits exactly on the 256-color palette is shorter as an index */
+	if(_ch & COLOR_CHANNEL_RGB) {
+		ri = _xterm_cube_level(r);
+		gi = _xterm_cube_level(g);
+		bi = _xterm_cube_level(b);
+		if(ri >= 0 && gi >= 0 && bi >= 0) {
+			result = 16 + ri * 36 + gi * 6 + bi;
+		} else if(r == g && g == b && r >= 8 && r <= 238 && (r - 8) % 10 == 0) {
+			result = 232 + (r - 8) / 10;
+		}
 	}
 
 	return result;
 }
 
-static s32 _collide_sprite(Ptr _data, Ptr _extra) {
+static s32 _format_channel_sgr(s8* _buf, u32 _ch, bl _bg) {
 	s32 result = 0;
-
-	Sprite* spr = (Sprite*)_data;
-	Canvas* cvs = (Canvas*)spr->owner;
-	if(spr->collide) {
-		spr->collide(cvs, spr, cvs->context.last_elapsed_time);
+	s32 base = _bg ? 10 : 0;
+
+	if(_ch & COLOR_CHANNEL_RGB) {
+		result = sprintf(_buf, "%d;2;%d;%d;%d", 38 + base, (_ch >> 16) & 0xFF, (_ch >> 8) & 0xFF, _ch & 0xFF);
+	} else if(_ch < 8) {
+		result = sprintf(_buf, "%d", 30 + base + _ch);
+	} else if(_ch < 16) {
+		result = sprintf(_buf, "%d", 90 + base + _ch - 8);
 	} else {
-		collide_sprite(cvs, spr, cvs->context.last_elapsed_time);
+		result = sprintf(_buf, "%d;5;%d", 38 + base, _ch & 0xFF);
 	}
 
 	return result;
 }
 
-static bl _create_sprite_shape(Canvas* _cvs, Sprite* _spr, const Str _shapeFile) {
-	bl result = TRUE;
-	FILE* fp = 0;
-	s8 buf[AGE_STR_LEN];
-	Str str = 0;
-	Str bs = buf;
-	s32 c = 0;
-	s32 w = 0;
-	s32 h = 0;
-	f32 r = 1.0f;
-	s32 i = 0;
-	s32 j = 0;
-	s32 k = 0;
-	Str fname = 0;
-	union { Ptr ptr; s32 sint; } u;
-	_spr->time_line.shape_file_name = copy_string(_shapeFile);
-	fp = fopen(_shapeFile, "rb+");
-	if(fp != 0) {
-		/* frame count */
-		freadln(fp, &bs);
-		str = buf + strlen(ST_SPRITE_FRAME_COUNT);
-		c = atoi(str);
-		/* frame width */
-		freadln(fp, &bs);
-		str = buf + strlen(ST_SPRITE_FRAME_WIDTH);
-		w = atoi(str);
-		/* frame height */
-		freadln(fp, &bs);
-		str = buf + strlen(ST_SPRITE_FRAME_HEIGHT);
-		h = atoi(str);
-		/* frame rate */
-		freadln(fp, &bs);
-		str = buf + strlen(ST_SPRITE_FRAME_RATE);
-		r = (f32)atof(str);
-		fskipln(fp);
-		/* assignment */
-		_spr->time_line.frame_count = c;
-		_spr->frame_size.w = w;
-		_spr->frame_size.h = h;
-		_spr->frame_rate = r;
-		/* frames */
-		_spr->time_line.frames = AGE_MALLOC_N(Frame, c);
-		for(k = 0; k < c; ++k) {
-			_spr->time_line.frames[k].parent = _spr;
-			_spr->time_line.frames[k].tex = AGE_MALLOC_N(Pixel, w * h);
-			for(j = 0; j < h; ++j) {
-				freadln(fp, &bs);
-				if(bs[0] == NAMED_FRAME_PREFIX) {
-					fname = copy_substring(bs, 1, 0);
-					u.sint = k;
-					ht_set_or_insert(_spr->time_line.named_frames, fname, u.ptr);
-					freadln(fp, &bs);
-				}
-				for(i = 0; i < w; ++i) {
-					_spr->time_line.frames[k].tex[i + j * w].parent = &_spr->time_line.frames[k];
-					_spr->time_line.frames[k].tex[i + j * w].shape = bs[i];
-				}
-			}
-			fskipln(fp);
-		}
-		/* close */
-		fclose(fp);
-	} else {
-		result = FALSE;
+static void _open_output(Canvas* _cvs) {
+#if AGE_VT_OUTPUT
+	HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+	DWORD mode = 0;
+
+	/* console calls are kept where virtual terminal processing is refused, redirected output is always a stream */
+	_cvs->stream.enabled = !GetConsoleMode(hOut, &mode) || SetConsoleMode(hOut, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+#endif
+	_cvs->context.last_position.x = -1;
+	_cvs->context.last_position.y = -1;
+}
+
+static void _flush_output(Canvas* _cvs) {
+	OutputStream* os = &_cvs->stream;
+
+	if(os->size) {
+		fwrite(os->data, 1, os->size, stdout);
+		fflush(stdout);
+		os->size = 0;
 	}
+}
 
-	return result;
+static void _close_output(Canvas* _cvs) {
+	_flush_output(_cvs);
+	if(_cvs->stream.data) {
+		AGE_FREE_N(_cvs->stream.data);
+	}
+	_cvs->stream.capacity = 0;
 }
 
-static bl _create_sprite_brush(Canvas* _cvs, Sprite* _spr, const Str _brushFile) {
-	bl result = TRUE;
-	FILE* fp = 0;
-	s8 buf[AGE_STR_LEN];
-	Str str = 0;
-	Str bs = buf;
-	s32 c = 0;
-	s32 w = 0;
-	s32 h = 0;
-	s32 i = 0;
-	s32 j = 0;
-	s32 k = 0;
-	_spr->time_line.brush_file_name = copy_string(_brushFile);
-	fp = fopen(_brushFile, "rb+");
-	if(fp != 0) {
-		/* frame count */
-		freadln(fp, &bs);
-		str = buf + strlen(ST_SPRITE_FRAME_COUNT);
-		c = atoi(str);
-		/* frame width */
-		freadln(fp, &bs);
-		str = buf + strlen(ST_SPRITE_FRAME_WIDTH);
-		w = atoi(str);
-		/* frame height */
-		freadln(fp, &bs);
-		str = buf + strlen(ST_SPRITE_FRAME_HEIGHT);
-		h = atoi(str);
-		fskipln(fp);
-		/* checking */
-		assert(_spr->time_line.frame_count == c);
-		assert(_spr->frame_size.w == w);
-		assert(_spr->frame_size.h == h);
-		/* frames */
-		for(k = 0; k < c; ++k) {
-			for(j = 0; j < h; ++j) {
-				freadln(fp, &bs);
-				for(i = 0; i < w; ++i) {
-					_spr->time_line.frames[k].tex[i + j * w].brush = bs[i];
-				}
-			}
-			fskipln(fp);
-		}
-		/* close */
-		fclose(fp);
+static void _clear_output(Canvas* _cvs) {
+	if(_cvs->stream.enabled) {
+		_write_stream(_cvs, "\x1b[2J", 4);
 	} else {
-		result = FALSE;
+		system("cls");
 	}
+	_cvs->context.last_position.x = -1;
+	_cvs->context.last_position.y = -1;
+}
 
-	return result;
+static void _output_char(Canvas* _cvs, s8 _ch) {
+	if(_cvs->stream.enabled) {
+		_write_stream(_cvs, &_ch, 1);
+	} else {
+		putch(_ch);
+	}
+	++_cvs->context.last_position.x;
 }
+#endif
 
-static bl _create_sprite_palete(Canvas* _cvs, Sprite* _spr, const Str _paleteFile) {
-	bl result = TRUE;
-	FILE* fp = 0;
-	s8 buf[AGE_STR_LEN];
-	Str str = 0;
-	Str bs = buf;
-	s32 c = 0;
-	Color palete[256];
+typedef bl (* _texel_filter)(const Texel* _tex);
+
+static bl _is_texel_drawn(const Texel* _tex) {
+	return _tex->shape != ERASE_PIXEL_SHAPE;
+}
+
+static bl _is_texel_erased(const Texel* _tex) {
+	return _tex->shape != 0;
+}
+
+static bl _is_texel_collided(const Texel* _tex) {
+	return _tex->shape != ERASE_PIXEL_SHAPE || _tex->brush != ERASE_PIXEL_SHAPE;
+}
+
+static s32 _compile_span_list(SpanList* _list, Span* _spans, const Texel* _tex, s32 _w, s32 _h, _texel_filter _filter) {
+	s32 result = 0;
 	s32 i = 0;
 	s32 j = 0;
-	s32 k = 0;
 	s32 b = 0;
-	memset(palete, 0, sizeof(palete));
-	_spr->time_line.palete_file_name = copy_string(_paleteFile);
-	fp = fopen(_paleteFile, "rb+");
-	if(fp != 0) {
-		while(!feof(fp)) {
-			freadln(fp, &bs);
-			if(strlen(bs) == 0) {
-				break;
+
+	/* only counts spans if no buffer given */
+	for(j = 0; j < _h; ++j) {
+		i = 0;
+		while(i < _w) {
+			if(!_filter(&_tex[i + j * _w])) {
+				++i;
+				continue;
 			}
-			str = buf + strlen("x: ");
-			c = atoi(str);
-			palete[(s32)buf[0]] = (Color)c;
-		}
-		/* close */
-		fclose(fp);
-		/* paint */
-		for(k = 0; k < _spr->time_line.frame_count; ++k) {
-			for(j = 0; j < _spr->frame_size.h; ++j) {
-				for(i = 0; i < _spr->frame_size.w; ++i) {
-					b = (s32)_spr->time_line.frames[k].tex[i + j * _spr->frame_size.w].brush;
-					_spr->time_line.frames[k].tex[i + j * _spr->frame_size.w].color = palete[b];
-				}
+			b = i;
+			while(i < _w && _filter(&_tex[i + j * _w])) {
+				++i;
+			}
+			if(_spans) {
+				_spans[result].x = b;
+				_spans[result].y = j;
+				_spans[result].len = i - b;
 			}
+			++result;
 		}
-	} else {
-		result = FALSE;
+	}
+	if(_list) {
+		_list->spans = result ? _spans : 0;
+		_list->count = result;
 	}
 
 	return result;
 }
 
-static bl _try_fill_pixel_collision(Pixel* _pixelc, Pixel* _pixelf, s32 _px, s32 _py) {
-	bl result = FALSE;
-	Sprite* _sprf = 0;
-	Sprite* _sprc = 0;
+static s32 _destroy_string(Ptr _data, Ptr _extra) {
+	s32 result = 0;
+	s32 k = 0;
+
+	Str fname = (Str)_extra;
+	AGE_FREE(fname);
+
+	return result;
+}
+
+static s32 _align_atlas_offset(s32 _offset) {
+	return (_offset + FRAME_ATLAS_ALIGNMENT - 1) & ~(FRAME_ATLAS_ALIGNMENT - 1);
+}
+
+static s32 _measure_frame_set(s32 _c, s32 _w, s32 _h, bl _withTexels) {
+	/* header, frames, texels and collision masks, spans are appended after them */
+	return
+		_align_atlas_offset(sizeof(FrameSet)) +
+		_align_atlas_offset(sizeof(Frame) * _c) +
+		(_withTexels ? _align_atlas_offset(sizeof(Texel) * _w * _h * _c) : 0) +
+		sizeof(u64) * COLLISION_MASK_STRIDE(_w) * _h * _c;
+}
+
+static void _locate_frames(FrameSet* _fs, bl _withTexels) {
+	s8* atlas = (s8*)_fs;
+	Texel* tex = 0;
+	u64* mask = 0;
+	s32 n = _fs->frame_size.w * _fs->frame_size.h;
+	s32 m = _fs->mask_stride * _fs->frame_size.h;
+	s32 k = 0;
+
+	/* frames follow the header, then texels of all frames in order, then collision masks */
+	_fs->frames = (Frame*)(atlas + _align_atlas_offset(sizeof(FrameSet)));
+	tex = (Texel*)((s8*)_fs->frames + _align_atlas_offset(sizeof(Frame) * _fs->frame_count));
+	mask = (u64*)((s8*)tex + (_withTexels ? _align_atlas_offset(sizeof(Texel) * n * _fs->frame_count) : 0));
+	for(k = 0; k < _fs->frame_count; ++k) {
+		if(_withTexels) {
+			_fs->frames[k].tex = tex + k * n;
+		}
+		_fs->frames[k].mask = mask + k * m;
+	}
+}
+
+static void _build_collision_mask(FrameSet* _fs, Frame* _frame) {
+	s32 w = _fs->frame_size.w;
+	s32 h = _fs->frame_size.h;
+	u64* row = 0;
+	s32 x = 0;
+	s32 y = 0;
+
+	memset(_frame->mask, 0, sizeof(u64) * _fs->mask_stride * h);
+	for(y = 0; y < h; ++y) {
+		row = _frame->mask + y * _fs->mask_stride;
+		for(x = 0; x < w; ++x) {
+			if(_is_texel_collided(&_frame->tex[x + y * w])) {
+				row[x >> 6] |= (u64)1 << (x & 63);
+			}
+		}
+	}
+}
+
+static void _build_collision_masks(FrameSet* _fs) {
+	s32 k = 0;
+
+	for(k = 0; k < _fs->frame_count; ++k) {
+		_build_collision_mask(_fs, &_fs->frames[k]);
+	}
+}
+
+static FrameSet* _create_frame_set(s32 _c, s32 _w, s32 _h, bl _withTexels) {
+	FrameSet* result = 0;
+	s32 size = 0;
+
+	/* texels of a mapped compiled asset are used in place */
+	size = _measure_frame_set(_c, _w, _h, _withTexels);
+	result = (FrameSet*)AGE_MALLOC_N(s8, size);
+	result->ref_count = 1;
+	result->size = size;
+	result->frame_size.w = _w;
+	result->frame_size.h = _h;
+	result->frame_count = _c;
+	result->mask_stride = COLLISION_MASK_STRIDE(_w);
+	result->named_frames = ht_create(0, ht_cmp_string, ht_hash_string, _destroy_string);
+	_locate_frames(result, _withTexels);
+
+	return result;
+}
+
+static FrameSet* _retain_frame_set(FrameSet* _fs) {
+	++_fs->ref_count;
+
+	return _fs;
+}
+
+static void _release_frame_set(FrameSet* _fs) {
+	s32 k = 0;
+
+	if(--_fs->ref_count == 0) {
+		for(k = 0; k < _fs->frame_count; ++k) {
+			if(_fs->frames[k].own_spans) {
+				AGE_FREE_N(_fs->frames[k].own_spans);
+			}
+		}
+		ht_destroy(_fs->named_frames);
+		if(_fs->mapped_view) {
+			unmap_file(_fs->mapped_view);
+		}
+		AGE_FREE(_fs);
+	}
+}
+
+static void _bind_frame_set(Sprite* _spr, FrameSet* _fs) {
+	_spr->time_line.frame_set = _fs;
+	_spr->time_line.frames = _fs->frames;
+	_spr->time_line.frame_count = _fs->frame_count;
+	_spr->time_line.named_frames = _fs->named_frames;
+	_spr->frame_size = _fs->frame_size;
+}
+
+static s32 _copy_named_frame(Ptr _data, Ptr _extra) {
+	s32 result = 0;
+
+	ht_set_or_insert(copyingNamedFrames, copy_string((Str)_extra), _data);
+
+	return result;
+}
+
+static FrameSet* _compile_frame_set(FrameSet* _fs) {
+	FrameSet* result = _fs;
+	s32 k = 0;
+	s32 n = 0;
+	s32 offset = 0;
+	s32 w = _fs->frame_size.w;
+	s32 h = _fs->frame_size.h;
+	Frame* frame = 0;
+	Span* spans = 0;
+
+	_build_collision_masks(_fs);
+	/* count spans of all frames, then grow the frame set once to append them */
+	for(k = 0; k < _fs->frame_count; ++k) {
+		frame = &_fs->frames[k];
+		n += _compile_span_list(0, 0, frame->tex, w, h, _is_texel_drawn);
+		n += _compile_span_list(0, 0, frame->tex, w, h, _is_texel_erased);
+		n += _compile_span_list(0, 0, frame->tex, w, h, _is_texel_collided);
+	}
+	if(!n) {
+		goto _exit;
+	}
+	offset = _align_atlas_offset(_fs->size);
+	result = (FrameSet*)AGE_REALLOC_N(s8, _fs, offset + sizeof(Span) * n);
+	result->size = offset + sizeof(Span) * n;
+	_locate_frames(result, TRUE);
+	spans = (Span*)((s8*)result + offset);
+	for(k = 0; k < result->frame_count; ++k) {
+		frame = &result->frames[k];
+		spans += _compile_span_list(&frame->draw_spans, spans, frame->tex, w, h, _is_texel_drawn);
+		spans += _compile_span_list(&frame->erase_spans, spans, frame->tex, w, h, _is_texel_erased);
+		spans += _compile_span_list(&frame->collide_spans, spans, frame->tex, w, h, _is_texel_collided);
+	}
+
+_exit:
+	return result;
+}
+
+static void _unshare_frame_set(Sprite* _spr) {
+	FrameSet* src = _spr->time_line.frame_set;
+	FrameSet* tgt = 0;
+	s32 k = 0;
+
+	/* copy on write, frame data is shared with other sprites or mapped read only */
+	if(src->ref_count == 1 && !src->mapped_view) {
+		return;
+	}
+	tgt = _create_frame_set(src->frame_count, src->frame_size.w, src->frame_size.h, TRUE);
+	tgt->frame_rate = src->frame_rate;
+	for(k = 0; k < src->frame_count; ++k) {
+		memcpy(tgt->frames[k].tex, src->frames[k].tex, sizeof(Texel) * src->frame_size.w * src->frame_size.h);
+	}
+	copyingNamedFrames = tgt->named_frames;
+	ht_foreach(src->named_frames, _copy_named_frame);
+	copyingNamedFrames = 0;
+	tgt = _compile_frame_set(tgt);
+	_release_frame_set(src);
+	_bind_frame_set(_spr, tgt);
+}
+
+typedef struct FrameSnapshot {
+	PresentedPixel* pixels;
+	bl clear;
+} FrameSnapshot;
+
+typedef struct Presenter {
+	PresentedPixel* composite;
+	PresentedPixel* front;
+	bl clear;
+	volatile LONG changed_pixel_count;
+	volatile LONG presented_frame_count;
+#if AGE_PRESENTER_THREAD
+	FrameSnapshot snapshots[3];
+	s32 back;
+	s32 ready;
+	s32 presenting;
+	bl has_ready;
+	bl running;
+	HANDLE thread_handle;
+	DWORD thread_id;
+	HANDLE event;
+	CRITICAL_SECTION lock;
+	CRITICAL_SECTION output_lock;
+#endif
+} Presenter;
+
+static void _enter_output(Canvas* _cvs) {
+#if AGE_PRESENTER_THREAD
+	/* guards output state against the presenter thread, reentrant as it calls the same output functions */
+	EnterCriticalSection(&((Presenter*)_cvs->presenter)->output_lock);
+#endif
+}
+
+static void _leave_output(Canvas* _cvs) {
+#if AGE_PRESENTER_THREAD
+	LeaveCriticalSection(&((Presenter*)_cvs->presenter)->output_lock);
+#endif
+}
+
+static void _compose_frame(Canvas* _cvs) {
+	Presenter* p = (Presenter*)_cvs->presenter;
+	s32 i = 0;
+	s32 n = _cvs->view_size.w * _cvs->view_size.h;
+	Pixel* pixelc = 0;
+	Pixel* pixelb = 0;
+	Pixel* pixelt = 0;
+	PresentedPixel* pixelp = 0;
+
+	for(i = 0; i < n; ++i) {
+		pixelc = &_cvs->pixels[i];
+		pixelt = &_cvs->texts[i];
+		pixelp = &p->composite[i];
+		if(pixelc->color == ERASE_PIXEL_COLOR) {
+			pixelb = &_cvs->background[i];
+			if(pixelt->shape) {
+				pixelp->shape = pixelt->shape;
+				pixelp->color = pixelt->color;
+			} else if(pixelb->shape) {
+				pixelp->shape = pixelb->shape;
+				pixelp->color = pixelb->color;
+			} else {
+				pixelp->shape = ERASE_PIXEL_SHAPE;
+				pixelp->color = get_mapped_color(0);
+			}
+			pixelc->color = 0;
+		} else if(pixelc->shape) {
+			if(pixelt->shape && _cvs->text_zorder <= pixelc->zorder) {
+				pixelp->shape = pixelt->shape;
+				pixelp->color = pixelt->color;
+			} else {
+				pixelp->shape = pixelc->shape;
+				pixelp->color = pixelc->color;
+			}
+		}
+	}
+}
+
+static void _present_pixels(Canvas* _cvs, const PresentedPixel* _pixels, bl _clear) {
+	Presenter* p = (Presenter*)_cvs->presenter;
+	s32 x = 0;
+	s32 y = 0;
+	s32 i = 0;
+	s32 n = _cvs->view_size.w * _cvs->view_size.h;
+	s32 changed = 0;
+	Color runColor = 0;
+	bl inRun = FALSE;
+	const PresentedPixel* pixels = 0;
+	PresentedPixel* pixelp = 0;
+
+	if(_clear) {
+		_clear_output(_cvs);
+		for(i = 0; i < n; ++i) {
+			p->front[i].shape = ERASE_PIXEL_SHAPE;
+			p->front[i].color = get_mapped_color(0);
+		}
+	}
+	/* render changed part of snapshot to target, adjacent changed pixels with same color are merged into a run */
+	for(y = 0; y < _cvs->view_size.h; ++y) {
+		inRun = FALSE;
+		for(x = 0; x < _cvs->view_size.w; ++x) {
+			pixels = &_pixels[x + y * _cvs->view_size.w];
+			pixelp = &p->front[x + y * _cvs->view_size.w];
+			if(!pixels->shape || (pixelp->shape == pixels->shape && pixelp->color == pixels->color)) {
+				inRun = FALSE;
+				continue;
+			}
+			if(!inRun || pixels->color != runColor) {
+				goto_xy(_cvs, x, y);
+				set_color(_cvs, pixels->color);
+				runColor = pixels->color;
+				inRun = TRUE;
+			}
+			_output_char(_cvs, pixels->shape);
+			*pixelp = *pixels;
+			++changed;
+		}
+	}
+	_flush_output(_cvs);
+	/* counters are read by the main thread while the presenter thread is presenting */
+	InterlockedExchange(&p->changed_pixel_count, changed);
+	InterlockedIncrement(&p->presented_frame_count);
+}
+
+#if AGE_PRESENTER_THREAD
+static s32 WINAPI _presenter_proc(Ptr _param) {
+	Canvas* cvs = (Canvas*)_param;
+	Presenter* p = (Presenter*)cvs->presenter;
+	FrameSnapshot* snap = 0;
+	bl running = TRUE;
+	s32 t = 0;
+
+	while(running) {
+		WaitForSingleObject(p->event, INFINITE);
+		snap = 0;
+		EnterCriticalSection(&p->lock); {
+			if(p->has_ready) {
+				t = p->presenting;
+				p->presenting = p->ready;
+				p->ready = t;
+				p->has_ready = FALSE;
+				snap = &p->snapshots[p->presenting];
+			}
+			running = p->running;
+		} LeaveCriticalSection(&p->lock);
+		if(snap) {
+			_enter_output(cvs);
+			_present_pixels(cvs, snap->pixels, snap->clear);
+			_leave_output(cvs);
+		}
+	}
+
+	return 0;
+}
+#endif
+
+static void _open_presenter(Canvas* _cvs) {
+	Presenter* p = AGE_MALLOC(Presenter);
+	s32 n = _cvs->view_size.w * _cvs->view_size.h;
+#if AGE_PRESENTER_THREAD
+	s32 i = 0;
+#endif
+
+	p->composite = AGE_MALLOC_N(PresentedPixel, n);
+	p->front = AGE_MALLOC_N(PresentedPixel, n);
+	_cvs->presenter = p;
+#if AGE_PRESENTER_THREAD
+	for(i = 0; i < _countof(p->snapshots); ++i) {
+		p->snapshots[i].pixels = AGE_MALLOC_N(PresentedPixel, n);
+	}
+	p->back = 0;
+	p->ready = 1;
+	p->presenting = 2;
+	p->running = TRUE;
+	InitializeCriticalSection(&p->lock);
+	InitializeCriticalSection(&p->output_lock);
+	p->event = CreateEvent(0, FALSE, FALSE, 0);
+	p->thread_handle = CreateThread(0, 0, _presenter_proc, _cvs, 0, &p->thread_id);
+#endif
+}
+
+static void _close_presenter(Canvas* _cvs) {
+	Presenter* p = (Presenter*)_cvs->presenter;
+#if AGE_PRESENTER_THREAD
+	s32 i = 0;
+
+	EnterCriticalSection(&p->lock); {
+		p->running = FALSE;
+	} LeaveCriticalSection(&p->lock);
+	SetEvent(p->event);
+	WaitForSingleObject(p->thread_handle, INFINITE);
+	CloseHandle(p->thread_handle);
+	CloseHandle(p->event);
+	DeleteCriticalSection(&p->lock);
+	DeleteCriticalSection(&p->output_lock);
+	for(i = 0; i < _countof(p->snapshots); ++i) {
+		AGE_FREE_N(p->snapshots[i].pixels);
+	}
+#endif
+	AGE_FREE_N(p->front);
+	AGE_FREE_N(p->composite);
+	AGE_FREE(_cvs->presenter);
+}
+
+static void _publish_frame(Canvas* _cvs) {
+	Presenter* p = (Presenter*)_cvs->presenter;
+#if AGE_PRESENTER_THREAD
+	FrameSnapshot* snap = &p->snapshots[p->back];
+	s32 t = 0;
+
+	memcpy(snap->pixels, p->composite, sizeof(PresentedPixel) * _cvs->view_size.w * _cvs->view_size.h);
+	snap->clear = p->clear;
+	p->clear = FALSE;
+	EnterCriticalSection(&p->lock); {
+		if(p->has_ready) {
+			/* the presenter is behind, drop the pending snapshot but keep its clearing request */
+			snap->clear |= p->snapshots[p->ready].clear;
+			++_cvs->dropped_frame_count;
+		}
+		t = p->ready;
+		p->ready = p->back;
+		p->back = t;
+		p->has_ready = TRUE;
+	} LeaveCriticalSection(&p->lock);
+	SetEvent(p->event);
+#else
+	_present_pixels(_cvs, p->composite, p->clear);
+	p->clear = FALSE;
+#endif
+}
+
+static void _insert_render_list(Canvas* _cvs, Sprite* _spr) {
+	s32 i = 0;
+
+	if(_cvs->render_list_count + 1 > _cvs->render_list_size) {
+		_cvs->render_list_size = _cvs->render_list_count + 8;
+		_cvs->render_list = AGE_REALLOC_N(Sprite*, _cvs->render_list, _cvs->render_list_size);
+	}
+	/* keep it sorted from back to front, a new sprite goes in front of others with the same z-order */
+	i = _cvs->render_list_count;
+	while(i > 0 && _cvs->render_list[i - 1]->zorder < _spr->zorder) {
+		_cvs->render_list[i] = _cvs->render_list[i - 1];
+		--i;
+	}
+	_cvs->render_list[i] = _spr;
+	++_cvs->render_list_count;
+}
+
+static void _damage_view(Canvas* _cvs, s32 _x, s32 _y, s32 _w, s32 _h) {
+	Rect* last = 0;
+	s32 r = 0;
+	s32 b = 0;
+
+	/* merge with the last area if touching, keeps a cleared region in one area */
+	if(_cvs->damaged_rects_count) {
+		last = &_cvs->damaged_rects[_cvs->damaged_rects_count - 1];
+		if(_x <= last->x + last->w && last->x <= _x + _w && _y <= last->y + last->h && last->y <= _y + _h) {
+			r = last->x + last->w > _x + _w ? last->x + last->w : _x + _w;
+			b = last->y + last->h > _y + _h ? last->y + last->h : _y + _h;
+			last->x = last->x < _x ? last->x : _x;
+			last->y = last->y < _y ? last->y : _y;
+			last->w = r - last->x;
+			last->h = b - last->y;
+
+			return;
+		}
+	}
+	if(_cvs->damaged_rects_count + 1 > _cvs->damaged_rects_size) {
+		_cvs->damaged_rects_size = _cvs->damaged_rects_count + 8;
+		_cvs->damaged_rects = AGE_REALLOC_N(Rect, _cvs->damaged_rects, _cvs->damaged_rects_size);
+	}
+	last = &_cvs->damaged_rects[_cvs->damaged_rects_count++];
+	last->x = _x;
+	last->y = _y;
+	last->w = _w;
+	last->h = _h;
+}
+
+static bl _is_view_damaged(Canvas* _cvs, s32 _x, s32 _y, s32 _w, s32 _h) {
+	bl result = FALSE;
+	Rect* rc = 0;
+	s32 i = 0;
+
+	for(i = 0; i < _cvs->damaged_rects_count; ++i) {
+		rc = &_cvs->damaged_rects[i];
+		if(_x < rc->x + rc->w && rc->x < _x + _w && _y < rc->y + rc->h && rc->y < _y + _h) {
+			result = TRUE;
+
+			break;
+		}
+	}
+
+	return result;
+}
+
+static bl _is_sprite_tinted(const Sprite* _spr) {
+	return _spr->tint.remap || _spr->tint.color != NO_TINT_COLOR || _spr->tint.gradient;
+}
+
+static Color _tint_texel_color(const SpriteTint* _tint, Color _col, s32 _x, s32 _y) {
+	Color result = _col;
+	s32 g = 0;
+
+	if(_tint->remap && !(_col & COLOR_EXTENDED) && _col < (Color)TINT_REMAP_SIZE) {
+		result = _tint->remap[_col];
+	}
+	if(_tint->color != NO_TINT_COLOR) {
+		result = _tint->color;
+	}
+	if(_tint->gradient) {
+		g = _x * _tint->gradient_step.x + _y * _tint->gradient_step.y;
+		if(g >= 0 && g < _tint->gradient_count && _tint->gradient[g] != NO_TINT_COLOR) {
+			result = _tint->gradient[g];
+		}
+	}
+
+	return result;
+}
+
+static void _recompile_frame(Sprite* _spr, s32 _frame) {
+	FrameSet* fs = _spr->time_line.frame_set;
+	Frame* frame = &fs->frames[_frame];
+	s32 w = fs->frame_size.w;
+	s32 h = fs->frame_size.h;
+	s32 n = 0;
+	Span* spans = 0;
+
+	/* only the edited frame is compiled again, its spans move out of the frame set block */
+	_build_collision_mask(fs, frame);
+	n += _compile_span_list(0, 0, frame->tex, w, h, _is_texel_drawn);
+	n += _compile_span_list(0, 0, frame->tex, w, h, _is_texel_erased);
+	n += _compile_span_list(0, 0, frame->tex, w, h, _is_texel_collided);
+	if(n) {
+		frame->own_spans = AGE_REALLOC_N(Span, frame->own_spans, n);
+		spans = frame->own_spans;
+		spans += _compile_span_list(&frame->draw_spans, spans, frame->tex, w, h, _is_texel_drawn);
+		spans += _compile_span_list(&frame->erase_spans, spans, frame->tex, w, h, _is_texel_erased);
+		spans += _compile_span_list(&frame->collide_spans, spans, frame->tex, w, h, _is_texel_collided);
+	} else {
+		if(frame->own_spans) {
+			AGE_FREE_N(frame->own_spans);
+		}
+		memset(&frame->draw_spans, 0, sizeof(SpanList));
+		memset(&frame->erase_spans, 0, sizeof(SpanList));
+		memset(&frame->collide_spans, 0, sizeof(SpanList));
+	}
+}
+
+static bl _clip_sprite_rect(const Sprite* _spr, s32 _frame, s32* _x, s32* _y, s32* _w, s32* _h) {
+	if(_frame < 0 || _frame > _spr->time_line.frame_count - 1) {
+		return FALSE;
+	}
+	if(*_x < 0) {
+		*_w += *_x;
+		*_x = 0;
+	}
+	if(*_y < 0) {
+		*_h += *_y;
+		*_y = 0;
+	}
+	if(*_x + *_w > _spr->frame_size.w) {
+		*_w = _spr->frame_size.w - *_x;
+	}
+	if(*_y + *_h > _spr->frame_size.h) {
+		*_h = _spr->frame_size.h - *_y;
+	}
+
+	return *_w > 0 && *_h > 0;
+}
+
+static void _copy_sprite_tint(SpriteTint* _tgt, const SpriteTint* _src) {
+	*_tgt = *_src;
+	if(_src->remap) {
+		_tgt->remap = AGE_MALLOC_N(Color, TINT_REMAP_SIZE);
+		memcpy(_tgt->remap, _src->remap, sizeof(Color) * TINT_REMAP_SIZE);
+	}
+	if(_src->gradient) {
+		_tgt->gradient = AGE_MALLOC_N(Color, _src->gradient_count);
+		memcpy(_tgt->gradient, _src->gradient, sizeof(Color) * _src->gradient_count);
+	}
+}
+
+static bl _is_sprite_dirty(Canvas* _cvs, Sprite* _spr) {
+	return
+		_spr->dirty || !_spr->drawn || _spr->visibility != VISIBILITY_VISIBLE ||
+		_spr->drawn_frame != _spr->time_line.current_frame ||
+		_spr->drawn_position.x != _spr->position.x - _cvs->camera.x ||
+		_spr->drawn_position.y != _spr->position.y - _cvs->camera.y;
+}
+
+static void _remove_render_list(Canvas* _cvs, Sprite* _spr) {
+	s32 i = 0;
+
+	for(i = 0; i < _cvs->render_list_count; ++i) {
+		if(_cvs->render_list[i] == _spr) {
+			--_cvs->render_list_count;
+			memmove(&_cvs->render_list[i], &_cvs->render_list[i + 1], sizeof(Sprite*) * (_cvs->render_list_count - i));
+
+			break;
+		}
+	}
+}
+
+static void _destroy_sprite_impl(Canvas* _cvs, Sprite* _spr) {
+	destroy_sprite_message_map(_spr);
+	if(_spr->time_line.shape_file_name) {
+		AGE_FREE(_spr->time_line.shape_file_name);
+	}
+	if(_spr->time_line.brush_file_name) {
+		AGE_FREE(_spr->time_line.brush_file_name);
+	}
+	if(_spr->time_line.palete_file_name) {
+		AGE_FREE(_spr->time_line.palete_file_name);
+	}
+	_release_frame_set(_spr->time_line.frame_set);
+	_spr->time_line.frame_set = 0;
+	_spr->time_line.frames = 0;
+	_spr->time_line.named_frames = 0;
+	if(_spr->time_line.begin_name) {
+		AGE_FREE(_spr->time_line.begin_name);
+	}
+	if(_spr->time_line.end_name) {
+		AGE_FREE(_spr->time_line.end_name);
+	}
+	if(_spr->userdata.destroy) {
+		assert(_spr->userdata.data);
+		_spr->userdata.destroy(_spr->userdata.data);
+	}
+	clear_sprite_tint(_cvs, _spr);
+	if(_spr->instances) {
+		if(_spr->instances->instances) {
+			AGE_FREE_N(_spr->instances->instances);
+		}
+		AGE_FREE(_spr->instances);
+	}
+	destroy_paramset(_spr->params);
+	AGE_FREE(_spr->name);
+	AGE_FREE(_spr);
+}
+
+static s32 _drop_sprite(Canvas* _cvs, Sprite* _spr) {
+	s32 result = 0;
+
+	++_cvs->dropped_sprites_count;
+	if(_cvs->dropped_sprites_count > _cvs->dropped_sprites_size) {
+		_cvs->dropped_sprites_size = _cvs->dropped_sprites_count + 8;
+		_cvs->dropped_sprites = AGE_REALLOC_N(Sprite*, _cvs->dropped_sprites, _cvs->dropped_sprites_size);
+	}
+	_cvs->dropped_sprites[_cvs->dropped_sprites_count - 1] = _spr;
+
+	return result;
+}
+
+static s32 _destroy_sprite(Ptr _data, Ptr _extra) {
+	s32 result = 0;
+
+	Sprite* spr = (Sprite*)_data;
+	_drop_sprite(spr->owner, spr);
+
+	return result;
+}
+
+static s32 _on_removing_sprite(Ptr _data, Ptr _extra) {
+	s32 result = 0;
+
+	Sprite* spr = (Sprite*)_data;
+	if(spr != tobeRemoved) {
+		if(spr->object_removed) {
+			spr->object_removed(spr, tobeRemoved->owner, tobeRemoved);
+		}
+	}
+
+	return result;
+}
+
+static s32 _update_sprite(Ptr _data, Ptr _extra) {
+	s32 result = 0;
+
+	Sprite* spr = (Sprite*)_data;
+	Canvas* cvs = (Canvas*)spr->owner;
+	if(spr->update) {
+		spr->update(cvs, spr, cvs->context.last_elapsed_time);
+	} else {
+		update_sprite(cvs, spr, cvs->context.last_elapsed_time);
+	}
+	if(spr->control) {
+		spr->control(
+			spr,
+			spr->name,
+			cvs->context.last_elapsed_time,
+			cvs->context.last_lparam,
+			cvs->context.last_wparam,
+			cvs->context.last_extra
+		);
+	}
+
+	return result;
+}
+
+static s32 _fire_render_sprite(Ptr _data, Ptr _extra) {
+	s32 result = 0;
+
+	Sprite* spr = (Sprite*)_data;
+	Canvas* cvs = (Canvas*)spr->owner;
+	if(spr->prev_render) {
+		spr->prev_render(cvs, spr, cvs->context.last_elapsed_time);
+	} else {
+		prev_render_sprite(cvs, spr, cvs->context.last_elapsed_time);
+	}
+
+	return result;
+}
+
+static s32 _post_render_sprite(Ptr _data, Ptr _extra) {
+	s32 result = 0;
+
+	Sprite* spr = (Sprite*)_data;
+	Canvas* cvs = (Canvas*)spr->owner;
+	if(spr->post_render) {
+		spr->post_render(cvs, spr, cvs->context.last_elapsed_time);
+	} else {
+		post_render_sprite(cvs, spr, cvs->context.last_elapsed_time);
+	}
+
+	return result;
+}
+
+static s32 _collide_sprite(Ptr _data, Ptr _extra) {
+	s32 result = 0;
+
+	Sprite* spr = (Sprite*)_data;
+	Canvas* cvs = (Canvas*)spr->owner;
+	if(spr->collide) {
+		spr->collide(cvs, spr, cvs->context.last_elapsed_time);
+	} else {
+		collide_sprite(cvs, spr, cvs->context.last_elapsed_time);
+	}
+
+	return result;
+}
+
+static Sprite* _alloc_sprite(Canvas* _cvs, const Str _name) {
+	Sprite* result = 0;
+
+	result = AGE_MALLOC(Sprite);
+	result->name = copy_string(_name);
+	result->visibility = VISIBILITY_VISIBLE;
+	result->zorder = DEFAULT_Z_ORDER;
+	result->tint.color = NO_TINT_COLOR;
+	result->params = create_paramset();
+	result->owner = _cvs;
+
+	return result;
+}
+
+static void _add_sprite(Canvas* _cvs, Sprite* _spr) {
+	create_sprite_message_map(_spr);
+
+	ht_set_or_insert(_cvs->sprites, _spr->name, _spr);
+	_insert_render_list(_cvs, _spr);
+}
+
+static FrameSet* _load_frame_set_shape(const Str _shapeFile) {
+	FrameSet* result = 0;
+	FILE* fp = 0;
+	s8 buf[AGE_STR_LEN];
+	Str str = 0;
+	Str bs = buf;
+	s32 c = 0;
+	s32 w = 0;
+	s32 h = 0;
+	f32 r = 1.0f;
+	s32 i = 0;
+	s32 j = 0;
+	s32 k = 0;
+	Str fname = 0;
+	union { Ptr ptr; s32 sint; } u;
+	fp = fopen(_shapeFile, "rb+");
+	if(fp != 0) {
+		/* frame count */
+		freadln(fp, &bs);
+		str = buf + strlen(ST_SPRITE_FRAME_COUNT);
+		c = atoi(str);
+		/* frame width */
+		freadln(fp, &bs);
+		str = buf + strlen(ST_SPRITE_FRAME_WIDTH);
+		w = atoi(str);
+		/* frame height */
+		freadln(fp, &bs);
+		str = buf + strlen(ST_SPRITE_FRAME_HEIGHT);
+		h = atoi(str);
+		/* frame rate */
+		freadln(fp, &bs);
+		str = buf + strlen(ST_SPRITE_FRAME_RATE);
+		r = (f32)atof(str);
+		fskipln(fp);
+		/* assignment */
+		result = _create_frame_set(c, w, h, TRUE);
+		result->frame_rate = r;
+		/* frames */
+		for(k = 0; k < c; ++k) {
+			for(j = 0; j < h; ++j) {
+				freadln(fp, &bs);
+				if(bs[0] == NAMED_FRAME_PREFIX) {
+					fname = copy_substring(bs, 1, 0);
+					u.sint = k;
+					ht_set_or_insert(result->named_frames, fname, u.ptr);
+					freadln(fp, &bs);
+				}
+				for(i = 0; i < w; ++i) {
+					result->frames[k].tex[i + j * w].shape = bs[i];
+				}
+			}
+			fskipln(fp);
+		}
+		/* close */
+		fclose(fp);
+	} else {
+		result = _create_frame_set(0, 0, 0, TRUE);
+	}
+
+	return result;
+}
+
+static bl _load_frame_set_brush(FrameSet* _fs, const Str _brushFile) {
+	bl result = TRUE;
+	FILE* fp = 0;
+	s8 buf[AGE_STR_LEN];
+	Str str = 0;
+	Str bs = buf;
+	s32 c = 0;
+	s32 w = 0;
+	s32 h = 0;
+	s32 i = 0;
+	s32 j = 0;
+	s32 k = 0;
+	fp = fopen(_brushFile, "rb+");
+	if(fp != 0) {
+		/* frame count */
+		freadln(fp, &bs);
+		str = buf + strlen(ST_SPRITE_FRAME_COUNT);
+		c = atoi(str);
+		/* frame width */
+		freadln(fp, &bs);
+		str = buf + strlen(ST_SPRITE_FRAME_WIDTH);
+		w = atoi(str);
+		/* frame height */
+		freadln(fp, &bs);
+		str = buf + strlen(ST_SPRITE_FRAME_HEIGHT);
+		h = atoi(str);
+		fskipln(fp);
+		/* checking */
+		assert(_fs->frame_count == c);
+		assert(_fs->frame_size.w == w);
+		assert(_fs->frame_size.h == h);
+		/* frames */
+		for(k = 0; k < c; ++k) {
+			for(j = 0; j < h; ++j) {
+				freadln(fp, &bs);
+				for(i = 0; i < w; ++i) {
+					_fs->frames[k].tex[i + j * w].brush = bs[i];
+				}
+			}
+			fskipln(fp);
+		}
+		/* close */
+		fclose(fp);
+	} else {
+		result = FALSE;
+	}
+
+	return result;
+}
+
+static u32 _parse_color_channel(const Str _str, Str* _end) {
+	u32 result = 0;
+
+	if(*_str == '@') {
+		result = (u32)strtol(_str + 1, _end, 10) & 0xFF;
+	} else if(*_str == '#') {
+		result = COLOR_CHANNEL_RGB | ((u32)strtol(_str + 1, _end, 16) & 0xFFFFFF);
+	} else {
+		*_end = (Str)_str;
+	}
+
+	return result;
+}
+
+static Color _parse_palete_color(const Str _str) {
+	Color result = 0;
+	u32 fg = 0;
+	u32 bg = 0;
+	Str end = 0;
+
+	/* either a console attribute as "15", or channels as "@208" or "#ff8000/#000000" */
+	if(*_str == '@' || *_str == '#') {
+		fg = _parse_color_channel(_str, &end);
+		if(*end == '/') {
+			bg = _parse_color_channel(end + 1, &end);
+		}
+		result = make_color(fg, bg);
+	} else {
+		result = (Color)atoi(_str);
+	}
+
+	return result;
+}
+
+static bl _load_frame_set_palete(FrameSet* _fs, const Str _paleteFile) {
+	bl result = TRUE;
+	FILE* fp = 0;
+	s8 buf[AGE_STR_LEN];
+	Str str = 0;
+	Str bs = buf;
+	Color palete[256];
+	s32 i = 0;
+	s32 j = 0;
+	s32 k = 0;
+	s32 b = 0;
+	memset(palete, 0, sizeof(palete));
+	fp = fopen(_paleteFile, "rb+");
+	if(fp != 0) {
+		while(!feof(fp)) {
+			freadln(fp, &bs);
+			if(strlen(bs) == 0) {
+				break;
+			}
+			str = buf + strlen("x: ");
+			palete[(u8)buf[0]] = _parse_palete_color(str);
+		}
+		/* close */
+		fclose(fp);
+		/* paint */
+		for(k = 0; k < _fs->frame_count; ++k) {
+			for(j = 0; j < _fs->frame_size.h; ++j) {
+				for(i = 0; i < _fs->frame_size.w; ++i) {
+					b = (s32)_fs->frames[k].tex[i + j * _fs->frame_size.w].brush;
+					_fs->frames[k].tex[i + j * _fs->frame_size.w].color = palete[b];
+				}
+			}
+		}
+	} else {
+		result = FALSE;
+	}
+
+	return result;
+}
+
+static FrameSet* _load_frame_set(const Str _shapeFile, const Str _brushFile, const Str _paleteFile) {
+	FrameSet* result = 0;
+
+	result = _load_frame_set_shape(_shapeFile);
+	_load_frame_set_brush(result, _brushFile);
+	_load_frame_set_palete(result, _paleteFile);
+	result = _compile_frame_set(result);
+
+	return result;
+}
+
+static void _write_asset_u32(FILE* _fp, u32 _val) {
+	fputc((s32)(_val & 0xFF), _fp);
+	fputc((s32)((_val >> 8) & 0xFF), _fp);
+	fputc((s32)((_val >> 16) & 0xFF), _fp);
+	fputc((s32)((_val >> 24) & 0xFF), _fp);
+}
+
+static u32 _read_asset_u32(const s8* _data) {
+	const u8* p = (const u8*)_data;
+
+	return (u32)p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static void _write_asset_header(FILE* _fp, const CompiledAssetHeader* _hdr) {
+	union { f32 real; u32 bits; } u;
+
+	u.real = _hdr->frame_rate;
+	fwrite(_hdr->magic, 1, sizeof(_hdr->magic), _fp);
+	_write_asset_u32(_fp, (u32)_hdr->version);
+	_write_asset_u32(_fp, (u32)_hdr->texel_size);
+	_write_asset_u32(_fp, (u32)_hdr->span_size);
+	_write_asset_u32(_fp, (u32)_hdr->frame_count);
+	_write_asset_u32(_fp, (u32)_hdr->width);
+	_write_asset_u32(_fp, (u32)_hdr->height);
+	_write_asset_u32(_fp, u.bits);
+	_write_asset_u32(_fp, (u32)_hdr->frames_offset);
+	_write_asset_u32(_fp, (u32)_hdr->texels_offset);
+	_write_asset_u32(_fp, (u32)_hdr->spans_offset);
+	_write_asset_u32(_fp, (u32)_hdr->span_count);
+	_write_asset_u32(_fp, (u32)_hdr->names_offset);
+	_write_asset_u32(_fp, (u32)_hdr->name_count);
+}
+
+static void _read_asset_header(const s8* _data, CompiledAssetHeader* _hdr) {
+	union { f32 real; u32 bits; } u;
+
+	memcpy(_hdr->magic, _data, sizeof(_hdr->magic));
+	_data += sizeof(_hdr->magic);
+	_hdr->version = (s32)_read_asset_u32(_data);
+	_hdr->texel_size = (s32)_read_asset_u32(_data + 4);
+	_hdr->span_size = (s32)_read_asset_u32(_data + 8);
+	_hdr->frame_count = (s32)_read_asset_u32(_data + 12);
+	_hdr->width = (s32)_read_asset_u32(_data + 16);
+	_hdr->height = (s32)_read_asset_u32(_data + 20);
+	u.bits = _read_asset_u32(_data + 24);
+	_hdr->frame_rate = u.real;
+	_hdr->frames_offset = (s32)_read_asset_u32(_data + 28);
+	_hdr->texels_offset = (s32)_read_asset_u32(_data + 32);
+	_hdr->spans_offset = (s32)_read_asset_u32(_data + 36);
+	_hdr->span_count = (s32)_read_asset_u32(_data + 40);
+	_hdr->names_offset = (s32)_read_asset_u32(_data + 44);
+	_hdr->name_count = (s32)_read_asset_u32(_data + 48);
+}
+
+static void _write_compiled_frame(FILE* _fp, const CompiledFrame* _cf) {
+	_write_asset_u32(_fp, (u32)_cf->draw_first);
+	_write_asset_u32(_fp, (u32)_cf->draw_count);
+	_write_asset_u32(_fp, (u32)_cf->erase_first);
+	_write_asset_u32(_fp, (u32)_cf->erase_count);
+	_write_asset_u32(_fp, (u32)_cf->collide_first);
+	_write_asset_u32(_fp, (u32)_cf->collide_count);
+}
+
+static void _read_compiled_frame(const s8* _data, CompiledFrame* _cf) {
+	_cf->draw_first = (s32)_read_asset_u32(_data);
+	_cf->draw_count = (s32)_read_asset_u32(_data + 4);
+	_cf->erase_first = (s32)_read_asset_u32(_data + 8);
+	_cf->erase_count = (s32)_read_asset_u32(_data + 12);
+	_cf->collide_first = (s32)_read_asset_u32(_data + 16);
+	_cf->collide_count = (s32)_read_asset_u32(_data + 20);
+}
+
+static void _write_asset_texel(FILE* _fp, const Texel* _tex) {
+	_write_asset_u32(_fp, _tex->color);
+	fputc((u8)_tex->shape, _fp);
+	fputc((u8)_tex->brush, _fp);
+	fputc(0, _fp);
+	fputc(0, _fp);
+}
+
+static void _write_asset_span_list(FILE* _fp, const SpanList* _list) {
+	s32 i = 0;
+
+	for(i = 0; i < _list->count; ++i) {
+		_write_asset_u32(_fp, (u32)_list->spans[i].x);
+		_write_asset_u32(_fp, (u32)_list->spans[i].y);
+		_write_asset_u32(_fp, (u32)_list->spans[i].len);
+	}
+}
+
+static bl _is_asset_layout_native(void) {
+	Texel tex;
+	u32 probe = 1;
+
+	/* a mapped file is used in place only if texels and spans are laid out in memory as in the file */
+	return sizeof(Texel) == (size_t)COMPILED_TEXEL_SIZE && sizeof(Span) == (size_t)COMPILED_SPAN_SIZE &&
+		(s8*)&tex.shape - (s8*)&tex == 4 && (s8*)&tex.brush - (s8*)&tex == 5 && *(u8*)&probe == 1;
+}
+
+static bl _is_asset_section_in(s32 _offset, s32 _unit, u64 _count, s32 _size) {
+	/* compared in 64 bits, offsets and counts come from the file */
+	return _offset >= 0 && _offset <= _size && _count <= (u64)(_size - _offset) / (u64)_unit;
+}
+
+static s32 _write_asset_padding(FILE* _fp, s32 _pos) {
+	s32 result = _align_atlas_offset(_pos);
+
+	while(_pos < result) {
+		fputc(0, _fp);
+		++_pos;
+	}
+
+	return result;
+}
+
+static s32 _write_named_frame(Ptr _data, Ptr _extra) {
+	s32 result = 0;
+	s32 len = (s32)strlen((Str)_extra) + 1;
+	union { Ptr ptr; s32 sint; } u;
+
+	u.ptr = _data;
+	_write_asset_u32(compilingAssetFile, (u32)u.sint);
+	_write_asset_u32(compilingAssetFile, (u32)len);
+	fwrite(_extra, 1, len, compilingAssetFile);
+	++compilingNameCount;
+
+	return result;
+}
+
+static bl _map_span_list(SpanList* _list, Span* _spans, s32 _spanCount, s32 _first, s32 _count) {
+	bl result = TRUE;
+
+	if(_first < 0 || _count < 0 || _count > _spanCount || _first > _spanCount - _count) {
+		result = FALSE;
+	} else {
+		_list->spans = _count ? _spans + _first : 0;
+		_list->count = _count;
+	}
+
+	return result;
+}
+
+static bl _is_span_in_frame(const Span* _span, s32 _w, s32 _h) {
+	return _span->x >= 0 && _span->len >= 0 && _span->len <= _w - _span->x && _span->y >= 0 && _span->y < _h;
+}
+
+static FrameSet* _map_frame_set(const Str _assetFile) {
+	FrameSet* result = 0;
+	s8* view = 0;
+	s32 size = 0;
+	s32 n = 0;
+	s32 i = 0;
+	s32 k = 0;
+	s32 pos = 0;
+	s32 idx = 0;
+	s32 len = 0;
+	bl native = _is_asset_layout_native();
+	CompiledAssetHeader hdr;
+	CompiledFrame cf;
+	const s8* data = 0;
+	Texel* texels = 0;
+	Texel* texel = 0;
+	Span* spans = 0;
+	Frame* frame = 0;
+	union { Ptr ptr; s32 sint; } u;
+
+	view = (s8*)map_file(_assetFile, &size);
+	if(!view || size < COMPILED_ASSET_HEADER_SIZE) {
+		goto _exit;
+	}
+	_read_asset_header(view, &hdr);
+	if(memcmp(hdr.magic, COMPILED_ASSET_MAGIC, sizeof(COMPILED_ASSET_MAGIC)) ||
+		hdr.version != COMPILED_ASSET_VERSION ||
+		hdr.texel_size != COMPILED_TEXEL_SIZE || hdr.span_size != COMPILED_SPAN_SIZE ||
+		hdr.frame_count < 0 || hdr.width < 0 || hdr.height < 0 || hdr.span_count < 0 ||
+		hdr.texels_offset % FRAME_ATLAS_ALIGNMENT || hdr.spans_offset % FRAME_ATLAS_ALIGNMENT
+	) {
+		goto _exit;
+	}
+	if((u64)hdr.width * (u64)hdr.height > (u64)size ||
+		!_is_asset_section_in(hdr.frames_offset, COMPILED_FRAME_SIZE, (u64)hdr.frame_count, size) ||
+		!_is_asset_section_in(hdr.texels_offset, COMPILED_TEXEL_SIZE, (u64)hdr.width * (u64)hdr.height * (u64)hdr.frame_count, size) ||
+		!_is_asset_section_in(hdr.spans_offset, COMPILED_SPAN_SIZE, (u64)hdr.span_count, size) ||
+		hdr.names_offset < 0 || hdr.names_offset > size
+	) {
+		goto _exit;
+	}
+	n = hdr.width * hdr.height;
+	if(native) {
+		/* only frame headers are allocated, texels and spans point into the view */
+		result = _create_frame_set(hdr.frame_count, hdr.width, hdr.height, FALSE);
+		result->mapped_view = view;
+		texels = (Texel*)(view + hdr.texels_offset);
+		spans = (Span*)(view + hdr.spans_offset);
+		for(i = 0; i < hdr.span_count; ++i) {
+			if(!_is_span_in_frame(&spans[i], hdr.width, hdr.height)) {
+				goto _error;
+			}
+		}
+		for(k = 0; k < hdr.frame_count; ++k) {
+			frame = &result->frames[k];
+			frame->tex = texels + n * k;
+			_read_compiled_frame(view + hdr.frames_offset + COMPILED_FRAME_SIZE * k, &cf);
+			if(!_map_span_list(&frame->draw_spans, spans, hdr.span_count, cf.draw_first, cf.draw_count) ||
+				!_map_span_list(&frame->erase_spans, spans, hdr.span_count, cf.erase_first, cf.erase_count) ||
+				!_map_span_list(&frame->collide_spans, spans, hdr.span_count, cf.collide_first, cf.collide_count)
+			) {
+				goto _error;
+			}
+		}
+		_build_collision_masks(result);
+	} else {
+		/* texels are decoded on a host with another layout, and spans are compiled again */
+		result = _create_frame_set(hdr.frame_count, hdr.width, hdr.height, TRUE);
+		data = view + hdr.texels_offset;
+		for(k = 0; k < hdr.frame_count; ++k) {
+			for(i = 0; i < n; ++i) {
+				texel = &result->frames[k].tex[i];
+				texel->color = _read_asset_u32(data);
+				texel->shape = data[4];
+				texel->brush = data[5];
+				data += COMPILED_TEXEL_SIZE;
+			}
+		}
+		result = _compile_frame_set(result);
+	}
+	result->frame_rate = hdr.frame_rate;
+	pos = hdr.names_offset;
+	for(k = 0; k < hdr.name_count; ++k) {
+		if(size - pos < (s32)sizeof(s32) * 2) {
+			goto _error;
+		}
+		idx = (s32)_read_asset_u32(view + pos);
+		len = (s32)_read_asset_u32(view + pos + sizeof(s32));
+		pos += sizeof(s32) * 2;
+		if(idx < 0 || idx >= result->frame_count || len <= 0 || len > size - pos || view[pos + len - 1] != '\0') {
+			goto _error;
+		}
+		u.sint = idx;
+		ht_set_or_insert(result->named_frames, copy_string(view + pos), u.ptr);
+		pos += len;
+	}
+	if(native) {
+		view = 0;
+	}
+	goto _exit;
+
+_error:
+	/* releasing a frame set unmaps its view */
+	_release_frame_set(result);
+	result = 0;
+	if(native) {
+		view = 0;
+	}
+
+_exit:
+	if(view) {
+		unmap_file(view);
+	}
+	if(!result) {
+		result = _create_frame_set(0, 0, 0, TRUE);
+	}
+
+	return result;
+}
+
+static Str _make_asset_key(const Str _shapeFile, const Str _brushFile, const Str _paleteFile) {
+	Str result = 0;
+
+	assert(!_brushFile == !_paleteFile);
+
+	/* a compiled asset file is cached by its own name, a lone brush or palete falls back to it too */
+	if(!_brushFile || !_paleteFile) {
+		result = copy_string(_shapeFile);
+	} else {
+		result = AGE_MALLOC_N(s8, strlen(_shapeFile) + strlen(_brushFile) + strlen(_paleteFile) + 3);
+		sprintf(result, "%s|%s|%s", _shapeFile, _brushFile, _paleteFile);
+	}
+
+	return result;
+}
+
+static FrameSet* _load_sprite_asset(const Str _shapeFile, const Str _brushFile, const Str _paleteFile) {
+	FrameSet* result = 0;
+
+	if(!_brushFile || !_paleteFile) {
+		result = _map_frame_set(_shapeFile);
+	} else {
+		result = _load_frame_set(_shapeFile, _brushFile, _paleteFile);
+	}
+
+	return result;
+}
+
+static void _cache_sprite_asset(Str _key, FrameSet* _fs) {
+	/* the cache keeps one reference until evicted */
+	if(!assetCache) {
+		assetCache = ht_create(0, ht_cmp_string, ht_hash_string, _destroy_string);
+	}
+	ht_set_or_insert(assetCache, _key, _fs);
+	++assetStats.asset_count;
+	assetStats.byte_count += _fs->size;
+}
+
+static FrameSet* _find_sprite_asset(const Str _shapeFile, const Str _brushFile, const Str _paleteFile, bl _load) {
+	FrameSet* result = 0;
+	Str key = 0;
+
+	key = _make_asset_key(_shapeFile, _brushFile, _paleteFile);
+	if(assetCache && ht_get(assetCache, key, &result)) {
+		++assetStats.hit_count;
+		AGE_FREE(key);
+	} else if(_load) {
+		++assetStats.miss_count;
+		result = _load_sprite_asset(_shapeFile, _brushFile, _paleteFile);
+		if(result->frame_count) {
+			_cache_sprite_asset(key, result);
+		} else {
+			/* failed loads are not cached, a later call retries the file */
+			_release_frame_set(result);
+			result = 0;
+			AGE_FREE(key);
+		}
+	} else {
+		AGE_FREE(key);
+	}
+
+	return result;
+}
+
+static s32 _collect_evictable_asset(Ptr _data, Ptr _extra) {
+	s32 result = 0;
+
+	FrameSet* fs = (FrameSet*)_data;
+	if(evictingAll || (!fs->pinned && fs->ref_count == 1)) {
+		evictingKeys[evictingCount++] = (Str)_extra;
+	}
+
+	return result;
+}
+
+static s32 WINAPI _asset_loading_proc(Ptr _param) {
+	AssetLoading* l = (AssetLoading*)_param;
+	AssetLoadingJob* job = 0;
+	s32 i = 0;
+
+	while(!l->cancelled) {
+		i = InterlockedIncrement(&l->next_job) - 1;
+		if(i >= l->job_count) {
+			break;
+		}
+		job = &l->jobs[i];
+		if(!job->skipped) {
+			/* parsing touches nothing shared, the cache is only filled while publishing */
+			job->frame_set = _load_sprite_asset(job->shape_file, job->brush_file, job->palete_file);
+			InterlockedExchange(&job->loaded, TRUE);
+			SetEvent(l->event);
+		}
+	}
+
+	return 0;
+}
+
+static void _join_asset_loading_workers(AssetLoading* _loading) {
+	s32 i = 0;
+
+	for(i = 0; i < _loading->worker_count; ++i) {
+		WaitForSingleObject(_loading->workers[i], INFINITE);
+		CloseHandle(_loading->workers[i]);
+	}
+	if(_loading->workers) {
+		AGE_FREE_N(_loading->workers);
+	}
+	_loading->worker_count = 0;
+}
+
+static void _publish_asset_loading(Canvas* _cvs, AssetLoading* _loading) {
+	AssetLoadingJob* job = 0;
+	Sprite* spr = 0;
+
+	/* publish in manifest order, so that sprites are created as if loaded synchronously */
+	while(_loading->published_count < _loading->job_count && !_loading->destroyed) {
+		job = &_loading->jobs[_loading->published_count];
+		if(!job->skipped && !InterlockedCompareExchange(&job->loaded, FALSE, FALSE)) {
+			break;
+		}
+		if(job->frame_set) {
+			if(!job->frame_set->frame_count || (assetCache && ht_find(assetCache, job->key))) {
+				_release_frame_set(job->frame_set);
+			} else {
+				++assetStats.miss_count;
+				_cache_sprite_asset(copy_string(job->key), job->frame_set);
+			}
+			job->frame_set = 0;
+		} else {
+			/* skipped entries were cached when queued, reload if evicted since */
+			_find_sprite_asset(job->shape_file, job->brush_file, job->palete_file, TRUE);
+		}
+		spr = 0;
+		if(job->sprite_name) {
+			if(job->brush_file) {
+				spr = create_sprite(_cvs, job->sprite_name, job->shape_file, job->brush_file, job->palete_file);
+			} else {
+				spr = create_sprite_from_asset(_cvs, job->sprite_name, job->shape_file);
+			}
+		}
+		++_loading->published_count;
+		if(_loading->loaded) {
+			_loading->loaded(_cvs, spr, _loading->published_count, _loading->job_count);
+		}
+	}
+	if(_loading->published_count == _loading->job_count) {
+		_join_asset_loading_workers(_loading);
+	}
+}
+
+static void _free_asset_loading(AssetLoading* _loading) {
+	AssetLoadingJob* job = 0;
+	s32 i = 0;
+
+	InterlockedExchange(&_loading->cancelled, TRUE);
+	_join_asset_loading_workers(_loading);
+	for(i = 0; i < _loading->job_count; ++i) {
+		job = &_loading->jobs[i];
+		if(job->frame_set) {
+			_release_frame_set(job->frame_set);
+		}
+		if(job->sprite_name) {
+			AGE_FREE(job->sprite_name);
+		}
+		AGE_FREE(job->shape_file);
+		if(job->brush_file) {
+			AGE_FREE(job->brush_file);
+		}
+		if(job->palete_file) {
+			AGE_FREE(job->palete_file);
+		}
+		AGE_FREE(job->key);
+	}
+	if(_loading->jobs) {
+		AGE_FREE_N(_loading->jobs);
+	}
+	CloseHandle(_loading->event);
+	AGE_FREE(_loading);
+}
+
+static void _sweep_asset_loadings(Canvas* _cvs) {
+	AssetLoading** l = &_cvs->loadings;
+	AssetLoading* loading = 0;
+
+	/* loadings destroyed by a callback, or detached and fully published, are freed out of publishing */
+	while(*l) {
+		loading = *l;
+		if(loading->destroyed || (loading->detached && loading->published_count == loading->job_count)) {
+			*l = loading->next;
+			_free_asset_loading(loading);
+		} else {
+			l = &loading->next;
+		}
+	}
+}
+
+static bl _is_sprite_in_view(Canvas* _cvs, Sprite* _spr, const Point* _pos) {
+	return
+		_pos->x < _cvs->view_size.w && _pos->x + _spr->frame_size.w > 0 &&
+		_pos->y < _cvs->view_size.h && _pos->y + _spr->frame_size.h > 0;
+}
+
+static PixelOwner* _alloc_pixel_owners(Canvas* _cvs, s32 _count) {
+	PixelOwner* result = 0;
+	OwnerChunk* chunk = _cvs->owner_chunk;
+
+	/* bump allocation, a chunk without enough room is left behind until next reset */
+	while(chunk && chunk->used + _count > chunk->size) {
+		chunk = chunk->next;
+		if(chunk) {
+			chunk->used = 0;
+		}
+	}
+	if(!chunk) {
+		chunk = (OwnerChunk*)AGE_MALLOC_N(s8, sizeof(OwnerChunk) + sizeof(PixelOwner) * (_count > OWNER_CHUNK_SIZE ? _count : OWNER_CHUNK_SIZE));
+		chunk->size = _count > OWNER_CHUNK_SIZE ? _count : OWNER_CHUNK_SIZE;
+		chunk->owners = (PixelOwner*)(chunk + 1);
+		if(_cvs->owner_chunk) {
+			chunk->next = _cvs->owner_chunk->next;
+			_cvs->owner_chunk->next = chunk;
+		} else {
+			_cvs->owner_arena = chunk;
+		}
+	}
+	_cvs->owner_chunk = chunk;
+	result = chunk->owners + chunk->used;
+	chunk->used += _count;
+
+	return result;
+}
+
+static void _reset_owner_arena(Canvas* _cvs) {
+	/* owners of all pixels are dropped by stamping, chunks are reused */
+	++_cvs->owner_stamp;
+	_cvs->owner_chunk = _cvs->owner_arena;
+	if(_cvs->owner_chunk) {
+		_cvs->owner_chunk->used = 0;
+	}
+}
+
+static PixelOwners* _get_pixel_owners(Canvas* _cvs, s32 _index) {
+	PixelOwners* result = &_cvs->owners[_index];
+
+	if(result->stamp != _cvs->owner_stamp) {
+		result->owners = 0;
+		result->owner_count = 0;
+		result->owner_size = 0;
+		result->stamp = _cvs->owner_stamp;
+	}
+
+	return result;
+}
+
+static void _add_pixel_owner(Canvas* _cvs, PixelOwners* _pixelc, Sprite* _spr, s32 _index) {
+	PixelOwner* owners = 0;
+
+	if(_pixelc->owner_count + 1 > _pixelc->owner_size) {
+		_pixelc->owner_size = _pixelc->owner_size ? _pixelc->owner_size * 2 : 4;
+		owners = _alloc_pixel_owners(_cvs, _pixelc->owner_size);
+		if(_pixelc->owner_count) {
+			memcpy(owners, _pixelc->owners, sizeof(PixelOwner) * _pixelc->owner_count);
+		}
+		_pixelc->owners = owners;
+	}
+	_pixelc->owners[_pixelc->owner_count].sprite = _spr;
+	_pixelc->owners[_pixelc->owner_count].index = _index;
+	++_pixelc->owner_count;
+}
+
+static void _call_pixel_collision(Sprite* _spr, s32 _index, s32 _px, s32 _py) {
+	/* a checker with a contact callback hears of each touching pair once, instead of each texel */
+	if(_spr->contacted && (_spr->physics_mode & PHYSICS_MODE_CHECKER) != PHYSICS_MODE_NULL) {
+		return;
+	}
+	/* an instance reports through its set, with its index, unless removed since filled */
+	if(_index != INVALID_FRAME_INDEX) {
+		if(_spr->instances && _index < _spr->instances->count && _spr->instances->collided) {
+			_spr->instances->collided(_spr->owner, _spr, _index, _px, _py);
+		}
+	} else if(_spr->collided) {
+		_spr->collided(_spr->owner, _spr, _px, _py);
+	}
+}
+
+static bl _try_fill_pixel_collision(PixelOwners* _pixelc, Sprite* _sprf, s32 _index, s32 _px, s32 _py) {
+	bl result = FALSE;
+	PixelOwner* _ownerc = 0;
 	u32 _pm = PHYSICS_MODE_NULL;
 	s32 i = 0;
 
-	assert(_pixelc && _pixelf);
+	assert(_pixelc && _sprf);
+
+	_pm = get_sprite_physics_mode(_sprf->owner, _sprf);
+
+	/* check */
+	if((_pm & PHYSICS_MODE_CHECKER) != PHYSICS_MODE_NULL) {
+		if(_pixelc->owner_count != 0) {
+			_call_pixel_collision(_sprf, _index, _px, _py);
+		}
+	}
+	/* fill */
+	if((_pm & PHYSICS_MODE_OBSTACLE) != PHYSICS_MODE_NULL) {
+		_add_pixel_owner(_sprf->owner, _pixelc, _sprf, _index); /* fill */
+		result = TRUE;
+		for(i = 0; i < _pixelc->owner_count; ++i) { /* check */
+			_ownerc = &_pixelc->owners[i];
+			if(_ownerc->sprite != _sprf || _ownerc->index != _index) {
+				_call_pixel_collision(_ownerc->sprite, _ownerc->index, _px, _py);
+			}
+		}
+	}
+
+	return result;
+}
+
+static void _erase_frame_spans(Canvas* _cvs, Sprite* _spr, s32 _index, const Frame* _frame, const Point* _pos) {
+	s32 i = 0;
+	s32 n = 0;
+	s32 x = 0;
+	s32 y = 0;
+	s32 e = 0;
+	s32 itf = 0;
+	Span* span = 0;
+	Pixel* pixelc = 0;
+	PixelOwners* ownersc = 0;
+
+	for(n = 0; n < _frame->erase_spans.count; ++n) {
+		span = &_frame->erase_spans.spans[n];
+		y = _pos->y + span->y;
+		if(y < 0 || y >= _cvs->view_size.h) {
+			continue;
+		}
+		i = span->x;
+		e = span->x + span->len;
+		if(_pos->x + i < 0) {
+			i = -_pos->x;
+		}
+		if(_pos->x + e > _cvs->view_size.w) {
+			e = _cvs->view_size.w - _pos->x;
+		}
+		for(; i < e; ++i) {
+			x = _pos->x + i;
+			pixelc = &_cvs->pixels[x + y * _cvs->view_size.w];
+			pixelc->shape = 0;
+			pixelc->color = ERASE_PIXEL_COLOR;
+			ownersc = _get_pixel_owners(_cvs, x + y * _cvs->view_size.w);
+			for(itf = 0; itf < ownersc->owner_count; ++itf) {
+				if(ownersc->owners[itf].sprite == _spr && ownersc->owners[itf].index == _index) {
+					ownersc->owners[itf] =
+						ownersc->owners[
+							--ownersc->owner_count
+						];
+				}
+			}
+		}
+	}
+}
+
+static void _draw_frame_spans(Canvas* _cvs, Sprite* _spr, const Frame* _frame, const Point* _pos, bl _tinted) {
+	s32 i = 0;
+	s32 n = 0;
+	s32 y = 0;
+	s32 e = 0;
+	Span* span = 0;
+	Texel* texf = 0;
+	Pixel* pixelc = 0;
+
+	for(n = 0; n < _frame->draw_spans.count; ++n) {
+		span = &_frame->draw_spans.spans[n];
+		y = _pos->y + span->y;
+		if(y < 0 || y >= _cvs->view_size.h) {
+			continue;
+		}
+		i = span->x;
+		e = span->x + span->len;
+		if(_pos->x + i < 0) {
+			i = -_pos->x;
+		}
+		if(_pos->x + e > _cvs->view_size.w) {
+			e = _cvs->view_size.w - _pos->x;
+		}
+		if(i >= e) {
+			continue;
+		}
+		texf = &_frame->tex[i + span->y * _spr->frame_size.w];
+		pixelc = &_cvs->pixels[_pos->x + i + y * _cvs->view_size.w];
+		if(_tinted) {
+			for(; i < e; ++i, ++texf, ++pixelc) {
+				pixelc->shape = texf->shape;
+				pixelc->color = _tint_texel_color(&_spr->tint, texf->color, i, span->y);
+				pixelc->zorder = _spr->zorder;
+			}
+		} else {
+			for(; i < e; ++i, ++texf, ++pixelc) {
+				pixelc->shape = texf->shape;
+				pixelc->color = texf->color;
+				pixelc->zorder = _spr->zorder;
+			}
+		}
+	}
+}
+
+static void _collide_frame_spans(Canvas* _cvs, Sprite* _spr, s32 _index, const Frame* _frame, const Point* _pos, const Point* _at) {
+	s32 i = 0;
+	s32 n = 0;
+	s32 y = 0;
+	s32 e = 0;
+	Span* span = 0;
+	PixelOwners* ownersc = 0;
+
+	for(n = 0; n < _frame->collide_spans.count; ++n) {
+		span = &_frame->collide_spans.spans[n];
+		y = _pos->y + span->y;
+		if(y < 0 || y >= _cvs->view_size.h) {
+			continue;
+		}
+		i = span->x;
+		e = span->x + span->len;
+		if(_pos->x + i < 0) {
+			i = -_pos->x;
+		}
+		if(_pos->x + e > _cvs->view_size.w) {
+			e = _cvs->view_size.w - _pos->x;
+		}
+		if(i >= e) {
+			continue;
+		}
+		for(; i < e; ++i) {
+			ownersc = _get_pixel_owners(_cvs, _pos->x + i + y * _cvs->view_size.w);
+			_try_fill_pixel_collision(ownersc, _spr, _index, _at->x + i, _at->y + span->y);
+		}
+	}
+}
+
+static void _add_collision_proxy(Canvas* _cvs, Sprite* _spr, s32 _index, const Point* _pos) {
+	CollisionProxy* proxy = 0;
+
+	if(_cvs->proxies_count + 1 > _cvs->proxies_size) {
+		_cvs->proxies_size = _cvs->proxies_size ? _cvs->proxies_size * 2 : 64;
+		_cvs->proxies = AGE_REALLOC_N(CollisionProxy, _cvs->proxies, _cvs->proxies_size);
+	}
+	proxy = &_cvs->proxies[_cvs->proxies_count++];
+	proxy->sprite = _spr;
+	proxy->index = _index;
+	proxy->box.x = _pos->x;
+	proxy->box.y = _pos->y;
+	proxy->box.w = _spr->frame_size.w;
+	proxy->box.h = _spr->frame_size.h;
+}
+
+static void _gather_collision_proxies(Canvas* _cvs) {
+	Sprite* spr = 0;
+	SpriteInstance* inst = 0;
+	s32 i = 0;
+	s32 k = 0;
+	Point pos;
+
+	_cvs->proxies_count = 0;
+	for(i = 0; i < _cvs->render_list_count; ++i) {
+		spr = _cvs->render_list[i];
+		spr->touched = FALSE;
+		for(k = 0; spr->instances && k < spr->instances->count; ++k) {
+			spr->instances->instances[k].touched = FALSE;
+		}
+		if(spr->visibility != VISIBILITY_VISIBLE || spr->physics_mode == PHYSICS_MODE_NULL) {
+			continue;
+		}
+		if(spr->instances) {
+			for(k = 0; k < spr->instances->count; ++k) {
+				inst = &spr->instances->instances[k];
+				pos.x = inst->position.x - _cvs->camera.x;
+				pos.y = inst->position.y - _cvs->camera.y;
+				if(inst->visible && _is_sprite_in_view(_cvs, spr, &pos)) {
+					_add_collision_proxy(_cvs, spr, k, &pos);
+				}
+			}
+		} else {
+			pos.x = spr->position.x - _cvs->camera.x;
+			pos.y = spr->position.y - _cvs->camera.y;
+			if(_is_sprite_in_view(_cvs, spr, &pos)) {
+				_add_collision_proxy(_cvs, spr, INVALID_FRAME_INDEX, &pos);
+			}
+		}
+	}
+}
+
+static void _locate_collision_cells(Canvas* _cvs, const Rect* _box, s32* _x0, s32* _y0, s32* _x1, s32* _y1) {
+	*_x0 = (_box->x > 0 ? _box->x : 0) / COLLISION_GRID_CELL_SIZE;
+	*_y0 = (_box->y > 0 ? _box->y : 0) / COLLISION_GRID_CELL_SIZE;
+	*_x1 = ((_box->x + _box->w < _cvs->view_size.w ? _box->x + _box->w : _cvs->view_size.w) - 1) / COLLISION_GRID_CELL_SIZE;
+	*_y1 = ((_box->y + _box->h < _cvs->view_size.h ? _box->y + _box->h : _cvs->view_size.h) - 1) / COLLISION_GRID_CELL_SIZE;
+}
+
+static void _sort_collision_grid(Canvas* _cvs) {
+	s32* cells = _cvs->grid_cells;
+	s32 n = _cvs->grid_size.w * _cvs->grid_size.h;
+	s32 x0 = 0;
+	s32 y0 = 0;
+	s32 x1 = 0;
+	s32 y1 = 0;
+	s32 x = 0;
+	s32 y = 0;
+	s32 i = 0;
+
+	/* counting sort, proxies of each cell are counted after the cell, then accumulated to first entries */
+	memset(cells, 0, sizeof(s32) * (n + 1));
+	for(i = 0; i < _cvs->proxies_count; ++i) {
+		_locate_collision_cells(_cvs, &_cvs->proxies[i].box, &x0, &y0, &x1, &y1);
+		for(y = y0; y <= y1; ++y) {
+			for(x = x0; x <= x1; ++x) {
+				++cells[x + y * _cvs->grid_size.w + 1];
+			}
+		}
+	}
+	for(i = 1; i <= n; ++i) {
+		cells[i] += cells[i - 1];
+	}
+	if(cells[n] > _cvs->grid_entries_size) {
+		_cvs->grid_entries_size = cells[n] * 2;
+		_cvs->grid_entries = AGE_REALLOC_N(s32, _cvs->grid_entries, _cvs->grid_entries_size);
+	}
+	/* each cell start is moved to the next cell while filling, then moved back */
+	for(i = 0; i < _cvs->proxies_count; ++i) {
+		_locate_collision_cells(_cvs, &_cvs->proxies[i].box, &x0, &y0, &x1, &y1);
+		for(y = y0; y <= y1; ++y) {
+			for(x = x0; x <= x1; ++x) {
+				_cvs->grid_entries[cells[x + y * _cvs->grid_size.w]++] = i;
+			}
+		}
+	}
+	for(i = n; i > 0; --i) {
+		cells[i] = cells[i - 1];
+	}
+	cells[0] = 0;
+}
+
+static s32 _count_mask_bits(u64 _bits) {
+	_bits = _bits - ((_bits >> 1) & 0x5555555555555555ULL);
+	_bits = (_bits & 0x3333333333333333ULL) + ((_bits >> 2) & 0x3333333333333333ULL);
+	_bits = (_bits + (_bits >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+
+	return (s32)((_bits * 0x0101010101010101ULL) >> 56);
+}
+
+static s32 _lowest_mask_bit(u64 _bits) {
+	s32 result = 0;
+
+	while(!(_bits & 1)) {
+		_bits >>= 1;
+		++result;
+	}
+
+	return result;
+}
+
+static s32 _highest_mask_bit(u64 _bits) {
+	s32 result = 63;
+
+	while(!(_bits >> 63)) {
+		_bits <<= 1;
+		--result;
+	}
+
+	return result;
+}
+
+static u64 _fetch_mask_bits(const u64* _row, s32 _stride, s32 _bit) {
+	u64 result = 0;
+	s32 w = _bit >> 6;
+	s32 s = _bit & 63;
+
+	/* 64 texels beginning at any column, bits after the row end are zero */
+	result = _row[w] >> s;
+	if(s && w + 1 < _stride) {
+		result |= _row[w + 1] << (64 - s);
+	}
+
+	return result;
+}
+
+static bl _test_frame_overlap(Sprite* _spr1, s32 _k1, const Point* _pos1, Sprite* _spr2, s32 _k2, const Point* _pos2, CollisionContact* _contact) {
+	bl result = FALSE;
+	s32 s1 = _spr1->time_line.frame_set->mask_stride;
+	s32 s2 = _spr2->time_line.frame_set->mask_stride;
+	const u64* m1 = _spr1->time_line.frames[_k1].mask;
+	const u64* m2 = _spr2->time_line.frames[_k2].mask;
+	s32 x0 = _pos1->x > _pos2->x ? _pos1->x : _pos2->x;
+	s32 y0 = _pos1->y > _pos2->y ? _pos1->y : _pos2->y;
+	s32 x1 = _pos1->x + _spr1->frame_size.w < _pos2->x + _spr2->frame_size.w ? _pos1->x + _spr1->frame_size.w : _pos2->x + _spr2->frame_size.w;
+	s32 y1 = _pos1->y + _spr1->frame_size.h < _pos2->y + _spr2->frame_size.h ? _pos1->y + _spr1->frame_size.h : _pos2->y + _spr2->frame_size.h;
+	s32 l = x1;
+	s32 t = y1;
+	s32 r = x0;
+	s32 b = y0;
+	s32 x = 0;
+	s32 y = 0;
+	u64 bits = 0;
+
+	if(_contact) {
+		memset(_contact, 0, sizeof(CollisionContact));
+	}
+	for(y = y0; y < y1; ++y) {
+		for(x = x0; x < x1; x += 64) {
+			bits =
+				_fetch_mask_bits(m1 + (y - _pos1->y) * s1, s1, x - _pos1->x) &
+				_fetch_mask_bits(m2 + (y - _pos2->y) * s2, s2, x - _pos2->x);
+			if(x1 - x < 64) {
+				bits &= ((u64)1 << (x1 - x)) - 1;
+			}
+			if(!bits) {
+				continue;
+			}
+			result = TRUE;
+			if(!_contact) {
+				goto _exit;
+			}
+			if(!_contact->count) {
+				_contact->first.x = x + _lowest_mask_bit(bits);
+				_contact->first.y = y;
+			}
+			_contact->count += _count_mask_bits(bits);
+			if(x + _lowest_mask_bit(bits) < l) {
+				l = x + _lowest_mask_bit(bits);
+			}
+			if(x + _highest_mask_bit(bits) + 1 > r) {
+				r = x + _highest_mask_bit(bits) + 1;
+			}
+			if(y < t) {
+				t = y;
+			}
+			b = y + 1;
+		}
+	}
+	if(result) {
+		_contact->bounds.x = l;
+		_contact->bounds.y = t;
+		_contact->bounds.w = r - l;
+		_contact->bounds.h = b - t;
+	}
+
+_exit:
+	return result;
+}
+
+static s32 _get_proxy_frame(const CollisionProxy* _proxy) {
+	if(_proxy->index == INVALID_FRAME_INDEX) {
+		return _proxy->sprite->time_line.current_frame;
+	}
+
+	return _proxy->sprite->instances->instances[_proxy->index].frame;
+}
+
+static bl _is_proxy_touched(const CollisionProxy* _proxy) {
+	if(_proxy->index == INVALID_FRAME_INDEX) {
+		return _proxy->sprite->touched;
+	}
+
+	return _proxy->sprite->instances->instances[_proxy->index].touched;
+}
+
+static bl _test_proxy_overlap(const CollisionProxy* _proxy1, const CollisionProxy* _proxy2, CollisionContact* _contact) {
+	Point pos1;
+	Point pos2;
+
+	pos1.x = _proxy1->box.x;
+	pos1.y = _proxy1->box.y;
+	pos2.x = _proxy2->box.x;
+	pos2.y = _proxy2->box.y;
+
+	return _test_frame_overlap(
+		_proxy1->sprite, _get_proxy_frame(_proxy1), &pos1,
+		_proxy2->sprite, _get_proxy_frame(_proxy2), &pos2,
+		_contact
+	);
+}
+
+static void _touch_collision_proxy(CollisionProxy* _proxy) {
+	if(_proxy->index == INVALID_FRAME_INDEX) {
+		_proxy->sprite->touched = TRUE;
+	} else {
+		_proxy->sprite->instances->instances[_proxy->index].touched = TRUE;
+	}
+}
+
+static bl _is_contact_wanted(Sprite* _spr, Sprite* _other) {
+	return
+		_spr->contacted &&
+		(_spr->physics_mode & PHYSICS_MODE_CHECKER) != PHYSICS_MODE_NULL &&
+		(_other->physics_mode & PHYSICS_MODE_OBSTACLE) != PHYSICS_MODE_NULL;
+}
+
+static void _add_sprite_contact(Canvas* _cvs, const CollisionProxy* _proxy1, const CollisionProxy* _proxy2, const CollisionContact* _contact) {
+	SpriteContact* contact = 0;
+
+	if(_cvs->contacts_count + 1 > _cvs->contacts_size) {
+		_cvs->contacts_size = _cvs->contacts_size ? _cvs->contacts_size * 2 : 16;
+		_cvs->contacts = AGE_REALLOC_N(SpriteContact, _cvs->contacts, _cvs->contacts_size);
+	}
+	contact = &_cvs->contacts[_cvs->contacts_count++];
+	contact->sprite = _proxy1->sprite;
+	contact->index = _proxy1->index;
+	contact->other = _proxy2->sprite;
+	contact->other_index = _proxy2->index;
+	/* tested in viewport, delivered in world */
+	contact->contact = *_contact;
+	contact->contact.bounds.x += _cvs->camera.x;
+	contact->contact.bounds.y += _cvs->camera.y;
+	contact->contact.first.x += _cvs->camera.x;
+	contact->contact.first.y += _cvs->camera.y;
+}
+
+static void _touch_collision_grid(Canvas* _cvs) {
+	CollisionProxy* a = 0;
+	CollisionProxy* b = 0;
+	s32 n = _cvs->grid_size.w * _cvs->grid_size.h;
+	s32 c = 0;
+	s32 i = 0;
+	s32 j = 0;
+	s32 x = 0;
+	s32 y = 0;
+	bl wanted = FALSE;
+	CollisionContact contact;
+
+	_cvs->contacts_count = 0;
+	for(c = 0; c < n; ++c) {
+		for(i = _cvs->grid_cells[c]; i < _cvs->grid_cells[c + 1]; ++i) {
+			a = &_cvs->proxies[_cvs->grid_entries[i]];
+			for(j = i + 1; j < _cvs->grid_cells[c + 1]; ++j) {
+				b = &_cvs->proxies[_cvs->grid_entries[j]];
+				/* instances of one sprite are paired with each other, never a proxy with itself */
+				if(a->sprite == b->sprite && a->index == b->index) {
+					continue;
+				}
+				if(!(a->box.x < b->box.x + b->box.w && b->box.x < a->box.x + a->box.w &&
+					a->box.y < b->box.y + b->box.h && b->box.y < a->box.y + a->box.h)
+				) {
+					continue;
+				}
+				/* a pair sharing several cells is tested in the cell of left top corner of its overlapping */
+				x = a->box.x > b->box.x ? a->box.x : b->box.x;
+				y = a->box.y > b->box.y ? a->box.y : b->box.y;
+				x = x > 0 ? x / COLLISION_GRID_CELL_SIZE : 0;
+				y = y > 0 ? y / COLLISION_GRID_CELL_SIZE : 0;
+				if(x + y * _cvs->grid_size.w != c) {
+					continue;
+				}
+				wanted = _is_contact_wanted(a->sprite, b->sprite) || _is_contact_wanted(b->sprite, a->sprite);
+				if(!wanted && _is_proxy_touched(a) && _is_proxy_touched(b)) {
+					continue;
+				}
+				if(!_test_proxy_overlap(a, b, wanted ? &contact : 0)) {
+					continue;
+				}
+				_touch_collision_proxy(a);
+				_touch_collision_proxy(b);
+				if(wanted) {
+					_add_sprite_contact(_cvs, a, b, &contact);
+				}
+			}
+		}
+	}
+}
+
+static void _deliver_sprite_contacts(Canvas* _cvs) {
+	SpriteContact* contact = 0;
+	SpriteContact swapped;
+	s32 i = 0;
+
+	for(i = 0; i < _cvs->contacts_count; ++i) {
+		contact = &_cvs->contacts[i];
+		if(_is_contact_wanted(contact->sprite, contact->other)) {
+			contact->sprite->contacted(_cvs, contact->sprite, contact);
+		}
+		if(_is_contact_wanted(contact->other, contact->sprite)) {
+			swapped = *contact;
+			swapped.sprite = contact->other;
+			swapped.index = contact->other_index;
+			swapped.other = contact->sprite;
+			swapped.other_index = contact->index;
+			swapped.sprite->contacted(_cvs, swapped.sprite, &swapped);
+		}
+	}
+}
+
+static bl _is_instance_set_dirty(Canvas* _cvs, Sprite* _spr) {
+	return
+		_spr->dirty || _spr->instances->changed || !_spr->drawn || _spr->visibility != VISIBILITY_VISIBLE ||
+		_cvs->camera.x != _cvs->last_camera.x || _cvs->camera.y != _cvs->last_camera.y;
+}
+
+static void _erase_sprite_instance(Canvas* _cvs, Sprite* _spr, s32 _index) {
+	SpriteInstance* inst = &_spr->instances->instances[_index];
+
+	if(inst->drawn_frame == INVALID_FRAME_INDEX) {
+		return;
+	}
+	_damage_view(_cvs, inst->drawn_position.x, inst->drawn_position.y, _spr->frame_size.w, _spr->frame_size.h);
+	_erase_frame_spans(_cvs, _spr, _index, &_spr->time_line.frames[inst->drawn_frame], &inst->drawn_position);
+	inst->drawn_frame = INVALID_FRAME_INDEX;
+}
+
+static void _prev_render_instances(Canvas* _cvs, Sprite* _spr) {
+	SpriteInstanceSet* set = _spr->instances;
+	s32 k = 0;
+
+	/* instances of a clean set are left in frame buffer as they are */
+	if(!_is_instance_set_dirty(_cvs, _spr)) {
+		return;
+	}
+	for(k = 0; k < set->count; ++k) {
+		_erase_sprite_instance(_cvs, _spr, k);
+	}
+}
+
+static void _post_render_instances(Canvas* _cvs, Sprite* _spr) {
+	SpriteInstanceSet* set = _spr->instances;
+	SpriteInstance* inst = 0;
+	Rect* bounds = &set->drawn_bounds;
+	bl tinted = FALSE;
+	s32 r = 0;
+	s32 b = 0;
+	s32 k = 0;
+	Point pos;
+
+	/* the whole set is redrawn if any instance changed, or its area was damaged */
+	if(!_is_instance_set_dirty(_cvs, _spr) && !_is_view_damaged(_cvs, bounds->x, bounds->y, bounds->w, bounds->h)) {
+		return;
+	}
+	_spr->dirty = FALSE;
+	_spr->drawn = TRUE;
+	set->changed = FALSE;
+	memset(bounds, 0, sizeof(Rect));
+	tinted = _is_sprite_tinted(_spr);
+	for(k = 0; k < set->count; ++k) {
+		inst = &set->instances[k];
+		pos.x = inst->position.x - _cvs->camera.x;
+		pos.y = inst->position.y - _cvs->camera.y;
+		if(!inst->visible || !_is_sprite_in_view(_cvs, _spr, &pos)) {
+			inst->drawn_frame = INVALID_FRAME_INDEX;
+
+			continue;
+		}
+		_damage_view(_cvs, pos.x, pos.y, _spr->frame_size.w, _spr->frame_size.h);
+		_draw_frame_spans(_cvs, _spr, &_spr->time_line.frames[inst->frame], &pos, tinted);
+		inst->drawn_position = pos;
+		inst->drawn_frame = inst->frame;
+		if(bounds->w == 0) {
+			bounds->x = pos.x;
+			bounds->y = pos.y;
+			bounds->w = _spr->frame_size.w;
+			bounds->h = _spr->frame_size.h;
+		} else {
+			r = bounds->x + bounds->w > pos.x + _spr->frame_size.w ? bounds->x + bounds->w : pos.x + _spr->frame_size.w;
+			b = bounds->y + bounds->h > pos.y + _spr->frame_size.h ? bounds->y + bounds->h : pos.y + _spr->frame_size.h;
+			bounds->x = bounds->x < pos.x ? bounds->x : pos.x;
+			bounds->y = bounds->y < pos.y ? bounds->y : pos.y;
+			bounds->w = r - bounds->x;
+			bounds->h = b - bounds->y;
+		}
+	}
+}
+
+static void _collide_instances(Canvas* _cvs, Sprite* _spr) {
+	SpriteInstanceSet* set = _spr->instances;
+	SpriteInstance* inst = 0;
+	s32 k = 0;
+	Point pos;
+
+	for(k = 0; k < set->count; ++k) {
+		inst = &set->instances[k];
+		pos.x = inst->position.x - _cvs->camera.x;
+		pos.y = inst->position.y - _cvs->camera.y;
+		if(!inst->visible || !inst->touched || !_is_sprite_in_view(_cvs, _spr, &pos)) {
+			continue;
+		}
+		_collide_frame_spans(_cvs, _spr, k, &_spr->time_line.frames[inst->frame], &pos, &inst->position);
+	}
+}
+
+static void _set_text_pixel(Canvas* _cvs, s32 _x, s32 _y, s8 _shape, Color _col) {
+	Pixel* pixelt = 0;
+	Pixel* pixelc = 0;
+
+	if(_x < 0 || _x >= _cvs->view_size.w || _y < 0 || _y >= _cvs->view_size.h) {
+		return;
+	}
+	pixelt = &_cvs->texts[_x + _y * _cvs->view_size.w];
+	if(pixelt->shape == _shape && pixelt->color == _col) {
+		return;
+	}
+	pixelt->shape = _shape;
+	pixelt->color = _col;
+	/* pixels covered by sprites are composited every frame, others need to be damaged */
+	pixelc = &_cvs->pixels[_x + _y * _cvs->view_size.w];
+	if(!pixelc->shape) {
+		pixelc->color = ERASE_PIXEL_COLOR;
+	}
+}
+
+static void _set_text_string(Canvas* _cvs, s32 _x, s32 _y, const Str _str, Color _col) {
+	s32 x = _x;
+	s32 y = _y;
+	const s8* c = _str;
+
+	for(c = _str; *c; ++c) {
+		if(*c == '\n') {
+			x = 0;
+			++y;
+		} else if(*c == '\r') {
+			x = 0;
+		} else {
+			_set_text_pixel(_cvs, x, y, *c, _col);
+			if(++x >= _cvs->view_size.w) {
+				x = 0;
+				++y;
+			}
+		}
+	}
+}
+
+Canvas* create_canvas(const Str _name, s32 _w, s32 _h) {
+	s32 count = 0;
+	Str name = copy_string(_name);
+	Canvas* result = AGE_MALLOC(Canvas);
+
+	assert(_w > 0 && _h > 0);
+
+	result->name = name;
+	result->params = create_paramset();
+	result->size.w = _w;
+	result->size.h = _h;
+	result->view_size.w = _w < CANVAS_WIDTH ? _w : CANVAS_WIDTH;
+	result->view_size.h = _h < CANVAS_HEIGHT ? _h : CANVAS_HEIGHT;
+	count = result->view_size.w * result->view_size.h;
+	result->pixels = AGE_MALLOC_N(Pixel, count);
+	result->background = AGE_MALLOC_N(Pixel, count);
+	result->texts = AGE_MALLOC_N(Pixel, count);
+	result->owners = AGE_MALLOC_N(PixelOwners, count);
+	result->owner_stamp = 1;
+	result->grid_size.w = (result->view_size.w + COLLISION_GRID_CELL_SIZE - 1) / COLLISION_GRID_CELL_SIZE;
+	result->grid_size.h = (result->view_size.h + COLLISION_GRID_CELL_SIZE - 1) / COLLISION_GRID_CELL_SIZE;
+	result->grid_cells = AGE_MALLOC_N(s32, (result->grid_size.w * result->grid_size.h + 1));
+	result->sprites = ht_create(0, ht_cmp_string, ht_hash_string, 0);
+	result->context.last_color = ERASE_PIXEL_COLOR;
+	_open_output(result);
+	_open_presenter(result);
+	create_canvas_message_map(result);
+
+	return result;
+}
+
+void destroy_canvas(Canvas* _cvs) {
+	s32 i = 0;
+	Sprite* spr = 0;
+	OwnerChunk* chunk = 0;
+
+	while(_cvs->loadings) {
+		destroy_asset_loading(_cvs, _cvs->loadings);
+	}
+	destroy_canvas_message_map(_cvs);
+	destroy_paramset(_cvs->params);
+	destroy_all_sprites(_cvs);
+
+	for(i = 0; i < _cvs->dropped_sprites_count; ++i) {
+		spr = _cvs->dropped_sprites[i];
+		_destroy_sprite_impl(_cvs, spr);
+	}
+	AGE_FREE_N(_cvs->dropped_sprites);
+	_cvs->dropped_sprites_size = 0;
+	_cvs->dropped_sprites_count = 0;
+
+	ht_destroy(_cvs->sprites);
+	if(_cvs->render_list) {
+		AGE_FREE_N(_cvs->render_list);
+	}
+	_cvs->render_list_size = 0;
+	if(_cvs->damaged_rects) {
+		AGE_FREE_N(_cvs->damaged_rects);
+	}
+	_cvs->damaged_rects_size = 0;
+	if(_cvs->proxies) {
+		AGE_FREE_N(_cvs->proxies);
+	}
+	_cvs->proxies_size = 0;
+	if(_cvs->grid_entries) {
+		AGE_FREE_N(_cvs->grid_entries);
+	}
+	_cvs->grid_entries_size = 0;
+	AGE_FREE_N(_cvs->grid_cells);
+	if(_cvs->contacts) {
+		AGE_FREE_N(_cvs->contacts);
+	}
+	_cvs->contacts_size = 0;
+
+	_close_presenter(_cvs);
+	_close_output(_cvs);
+	while(_cvs->owner_arena) {
+		chunk = _cvs->owner_arena;
+		_cvs->owner_arena = chunk->next;
+		AGE_FREE(chunk);
+	}
+	AGE_FREE_N(_cvs->owners);
+	AGE_FREE_N(_cvs->texts);
+	AGE_FREE_N(_cvs->background);
+	AGE_FREE_N(_cvs->pixels);
+	AGE_FREE(_cvs->name);
+	AGE_FREE(_cvs);
+}
+
+void set_frame_rate(Canvas* _cvs, s32 _rate) {
+	assert(_cvs && _rate > 0);
+
+	_cvs->frame_rate = _rate;
+}
+
+s32 get_frame_rate(Canvas* _cvs) {
+	assert(_cvs);
+
+	return _cvs->frame_rate;
+}
+
+void set_canvas_camera(Canvas* _cvs, s32 _x, s32 _y) {
+	assert(_cvs);
+
+	if(_x > _cvs->size.w - _cvs->view_size.w) {
+		_x = _cvs->size.w - _cvs->view_size.w;
+	}
+	if(_x < 0) {
+		_x = 0;
+	}
+	if(_y > _cvs->size.h - _cvs->view_size.h) {
+		_y = _cvs->size.h - _cvs->view_size.h;
+	}
+	if(_y < 0) {
+		_y = 0;
+	}
+	_cvs->camera.x = _x;
+	_cvs->camera.y = _y;
+}
+
+void get_canvas_camera(Canvas* _cvs, s32* _x, s32* _y) {
+	assert(_cvs);
+
+	if(_x) {
+		*_x = _cvs->camera.x;
+	}
+	if(_y) {
+		*_y = _cvs->camera.y;
+	}
+}
+
+PixelOwners* get_pixel_owners(Canvas* _cvs, s32 _x, s32 _y) {
+	PixelOwners* result = 0;
+
+	assert(_cvs);
+
+	_x -= _cvs->camera.x;
+	_y -= _cvs->camera.y;
+	if(_x >= 0 && _x < _cvs->view_size.w && _y >= 0 && _y < _cvs->view_size.h) {
+		result = _get_pixel_owners(_cvs, _x + _y * _cvs->view_size.w);
+	}
+
+	return result;
+}
+
+s32 get_changed_pixel_count(Canvas* _cvs) {
+	assert(_cvs);
+
+	return (s32)InterlockedCompareExchange(&((Presenter*)_cvs->presenter)->changed_pixel_count, 0, 0);
+}
+
+u32 get_presented_frame_count(Canvas* _cvs) {
+	assert(_cvs);
+
+	return (u32)InterlockedCompareExchange(&((Presenter*)_cvs->presenter)->presented_frame_count, 0, 0);
+}
+
+u32 get_dropped_frame_count(Canvas* _cvs) {
+	assert(_cvs);
+
+	return _cvs->dropped_frame_count;
+}
+
+bl present_pixels(Canvas* _cvs, const Playback* _pb) {
+	bl result = FALSE;
+	Presenter* p = 0;
+
+	assert(_cvs && _pb);
+
+	if(_pb->size.w != _cvs->view_size.w || _pb->size.h != _cvs->view_size.h) {
+		goto _exit;
+	}
+	p = (Presenter*)_cvs->presenter;
+	memcpy(p->composite, _pb->pixels, sizeof(PresentedPixel) * _cvs->view_size.w * _cvs->view_size.h);
+	_publish_frame(_cvs);
+	result = TRUE;
+
+_exit:
+	return result;
+}
+
+void collide_canvas(Canvas* _cvs, s32 _elapsedTime) {
+	/* broad phase, pixels are tested only for sprites touching others, then contacts are delivered once for each pair */
+	_gather_collision_proxies(_cvs);
+	_sort_collision_grid(_cvs);
+	_touch_collision_grid(_cvs);
+	ht_foreach(_cvs->sprites, _collide_sprite);
+	_deliver_sprite_contacts(_cvs);
+}
+
+void update_canvas(Canvas* _cvs, s32 _elapsedTime) {
+	control_proc ctrl = 0;
+	AssetLoading* loading = 0;
+	bl publishing = FALSE;
+
+	_cvs->context.last_elapsed_time = _elapsedTime;
+	_cvs->context.last_lparam = 0;
+	_cvs->context.last_wparam = 0;
+	_cvs->context.last_extra = 0;
+
+	ctrl = get_canvas_controller(_cvs);
+	if(ctrl) {
+		ctrl(_cvs, _cvs->name, _elapsedTime, 0, 0, 0);
+	}
+
+	ht_foreach(_cvs->sprites, _update_sprite);
+
+	publishing = _cvs->publishing_loadings;
+	_cvs->publishing_loadings = TRUE;
+	for(loading = _cvs->loadings; loading; loading = loading->next) {
+		_publish_asset_loading(_cvs, loading);
+	}
+	_cvs->publishing_loadings = publishing;
+	if(!publishing) {
+		_sweep_asset_loadings(_cvs);
+	}
+}
+
+void tidy_canvas(Canvas* _cvs, s32 _elapsedTime) {
+	Sprite* spr = 0;
+	s32 i = 0;
+
+	for(i = 0; i < _cvs->dropped_sprites_count; ++i) {
+		spr = _cvs->dropped_sprites[i];
+		_destroy_sprite_impl(_cvs, spr);
+	}
+	if(_cvs->dropped_sprites_size - _cvs->dropped_sprites_count > 16) {
+		AGE_FREE_N(_cvs->dropped_sprites);
+		_cvs->dropped_sprites_size = 0;
+	}
+	_cvs->dropped_sprites_count = 0;
+}
+
+void render_canvas(Canvas* _cvs, s32 _elapsedTime) {
+	s32 i = 0;
+
+	/* fill frame buffer */
+	if(_cvs->prev_render) {
+		_cvs->prev_render(_cvs, _elapsedTime);
+	}
+	for(i = 0; i < _cvs->render_list_count; ++i) {
+		_fire_render_sprite(_cvs->render_list[i], 0);
+	}
+	_reset_owner_arena(_cvs);
+	for(i = 0; i < _cvs->render_list_count; ++i) {
+		_post_render_sprite(_cvs->render_list[i], 0);
+	}
+	_cvs->damaged_rects_count = 0;
+	_cvs->last_camera = _cvs->camera;
+	if(_cvs->post_render) {
+		_cvs->post_render(_cvs, _elapsedTime);
+	}
+
+	/* compose layers and present */
+	_compose_frame(_cvs);
+	if(_cvs->recorder) {
+		/* a recorder of another canvas would read past the composite */
+		assert(_cvs->recorder->size.w == _cvs->view_size.w && _cvs->recorder->size.h == _cvs->view_size.h);
+		if(_cvs->recorder->size.w == _cvs->view_size.w && _cvs->recorder->size.h == _cvs->view_size.h) {
+			record_frame(_cvs->recorder, ((Presenter*)_cvs->presenter)->composite, _elapsedTime);
+		}
+	}
+	_publish_frame(_cvs);
+}
+
+Sprite* get_sprite_by_name(Canvas* _cvs, const Str _name) {
+	Sprite* result = 0;
+
+	assert(_cvs);
+
+	ht_get(_cvs->sprites, _name, &result);
+
+	return result;
+}
+
+static Sprite* _create_sprite(Canvas* _cvs, const Str _name, const Str _shapeFile, const Str _brushFile, const Str _paleteFile) {
+	Sprite* result = 0;
+	FrameSet* fs = 0;
+
+	assert(_cvs);
+
+	if(!get_sprite_by_name(_cvs, _name)) {
+		result = _alloc_sprite(_cvs, _name);
+		result->time_line.shape_file_name = copy_string(_shapeFile);
+		if(_brushFile) {
+			result->time_line.brush_file_name = copy_string(_brushFile);
+		}
+		if(_paleteFile) {
+			result->time_line.palete_file_name = copy_string(_paleteFile);
+		}
+
+		fs = _find_sprite_asset(_shapeFile, _brushFile, _paleteFile, TRUE);
+		if(fs) {
+			result->frame_rate = fs->frame_rate;
+			_bind_frame_set(result, _retain_frame_set(fs));
+		} else {
+			_bind_frame_set(result, _create_frame_set(0, 0, 0, TRUE));
+		}
+
+		_add_sprite(_cvs, result);
+	}
+
+	return result;
+}
+
+Sprite* create_sprite(Canvas* _cvs, const Str _name, const Str _shapeFile, const Str _brushFile, const Str _paleteFile) {
+	assert(_shapeFile && _brushFile && _paleteFile);
+
+	return _create_sprite(_cvs, _name, _shapeFile, _brushFile, _paleteFile);
+}
+
+Sprite* create_sprite_from_asset(Canvas* _cvs, const Str _name, const Str _assetFile) {
+	assert(_assetFile);
+
+	return _create_sprite(_cvs, _name, _assetFile, 0, 0);
+}
+
+bl compile_sprite_asset(const Str _shapeFile, const Str _brushFile, const Str _paleteFile, const Str _assetFile) {
+	bl result = FALSE;
+	FrameSet* fs = 0;
+	FILE* fp = 0;
+	Frame* frame = 0;
+	CompiledAssetHeader hdr;
+	CompiledFrame cf;
+	s32 pos = 0;
+	s32 i = 0;
+	s32 k = 0;
+
+	assert(_shapeFile && _brushFile && _paleteFile && _assetFile);
+
+	fs = _load_frame_set(_shapeFile, _brushFile, _paleteFile);
+	if(!fs->frame_count) {
+		goto _exit;
+	}
+	fp = fopen(_assetFile, "wb");
+	if(!fp) {
+		goto _exit;
+	}
+	memset(&hdr, 0, sizeof(CompiledAssetHeader));
+	memcpy(hdr.magic, COMPILED_ASSET_MAGIC, sizeof(COMPILED_ASSET_MAGIC));
+	hdr.version = COMPILED_ASSET_VERSION;
+	hdr.texel_size = COMPILED_TEXEL_SIZE;
+	hdr.span_size = COMPILED_SPAN_SIZE;
+	hdr.frame_count = fs->frame_count;
+	hdr.width = fs->frame_size.w;
+	hdr.height = fs->frame_size.h;
+	hdr.frame_rate = fs->frame_rate;
+	/* header is written again when all offsets are known */
+	_write_asset_header(fp, &hdr);
+	pos = COMPILED_ASSET_HEADER_SIZE;
+	/* frames */
+	hdr.frames_offset = pos;
+	for(k = 0; k < fs->frame_count; ++k) {
+		frame = &fs->frames[k];
+		cf.draw_first = hdr.span_count;
+		cf.draw_count = frame->draw_spans.count;
+		cf.erase_first = cf.draw_first + cf.draw_count;
+		cf.erase_count = frame->erase_spans.count;
+		cf.collide_first = cf.erase_first + cf.erase_count;
+		cf.collide_count = frame->collide_spans.count;
+		hdr.span_count = cf.collide_first + cf.collide_count;
+		_write_compiled_frame(fp, &cf);
+		pos += COMPILED_FRAME_SIZE;
+	}
+	/* texels */
+	pos = _write_asset_padding(fp, pos);
+	hdr.texels_offset = pos;
+	for(k = 0; k < fs->frame_count; ++k) {
+		for(i = 0; i < fs->frame_size.w * fs->frame_size.h; ++i) {
+			_write_asset_texel(fp, &fs->frames[k].tex[i]);
+		}
+		pos += COMPILED_TEXEL_SIZE * fs->frame_size.w * fs->frame_size.h;
+	}
+	/* spans */
+	pos = _write_asset_padding(fp, pos);
+	hdr.spans_offset = pos;
+	for(k = 0; k < fs->frame_count; ++k) {
+		frame = &fs->frames[k];
+		_write_asset_span_list(fp, &frame->draw_spans);
+		_write_asset_span_list(fp, &frame->erase_spans);
+		_write_asset_span_list(fp, &frame->collide_spans);
+	}
+	pos += COMPILED_SPAN_SIZE * hdr.span_count;
+	/* named frames */
+	hdr.names_offset = pos;
+	compilingAssetFile = fp;
+	compilingNameCount = 0;
+	ht_foreach(fs->named_frames, _write_named_frame);
+	hdr.name_count = compilingNameCount;
+	compilingAssetFile = 0;
+	compilingNameCount = 0;
+	fseek(fp, 0, SEEK_SET);
+	_write_asset_header(fp, &hdr);
+	result = !ferror(fp);
+
+_exit:
+	if(fp) {
+		fclose(fp);
+	}
+	_release_frame_set(fs);
+
+	return result;
+}
+
+Sprite* clone_sprite(Canvas* _cvs, const Str _srcName, const Str _tgtName) {
+	Sprite* result = 0;
+	Sprite* src = 0;
+
+	src = get_sprite_by_name(_cvs, _srcName);
+	result = get_sprite_by_name(_cvs, _tgtName);
+	assert(src && !result);
+	if(src && !result) {
+		/* share frame data with source, it will be copied before writing */
+		result = _alloc_sprite(_cvs, _tgtName);
+		result->time_line.shape_file_name = copy_string(src->time_line.shape_file_name);
+		if(src->time_line.brush_file_name) {
+			result->time_line.brush_file_name = copy_string(src->time_line.brush_file_name);
+		}
+		if(src->time_line.palete_file_name) {
+			result->time_line.palete_file_name = copy_string(src->time_line.palete_file_name);
+		}
+		result->frame_rate = src->frame_rate;
+		_bind_frame_set(result, _retain_frame_set(src->time_line.frame_set));
+		_add_sprite(_cvs, result);
+
+		set_sprite_zorder(_cvs, result, src->zorder);
+		result->physics_mode = src->physics_mode;
+		result->collided = src->collided;
+		result->contacted = src->contacted;
+		result->control = src->control;
+		result->object_removed = src->object_removed;
+		result->update = src->update;
+		result->prev_render = src->prev_render;
+		result->post_render = src->post_render;
+		_copy_sprite_tint(&result->tint, &src->tint);
+		copy_message_map(&src->message_map, &result->message_map);
+	} else {
+		result = 0;
+	}
+
+	return result;
+}
+
+bl preload_sprite_asset(const Str _shapeFile, const Str _brushFile, const Str _paleteFile) {
+	bl result = FALSE;
+	FrameSet* fs = 0;
+
+	assert(_shapeFile && !_brushFile == !_paleteFile);
+
+	fs = _find_sprite_asset(_shapeFile, _brushFile, _paleteFile, TRUE);
+	result = !!fs;
+
+	return result;
+}
+
+bl pin_sprite_asset(const Str _shapeFile, const Str _brushFile, const Str _paleteFile, bl _pin) {
+	bl result = FALSE;
+	FrameSet* fs = 0;
+
+	assert(_shapeFile && !_brushFile == !_paleteFile);
+
+	fs = _find_sprite_asset(_shapeFile, _brushFile, _paleteFile, _pin);
+	if(fs) {
+		fs->pinned = _pin;
+		result = TRUE;
+	}
+
+	return result;
+}
+
+s32 evict_sprite_assets(bl _all) {
+	s32 result = 0;
+	s32 i = 0;
+	FrameSet* fs = 0;
+
+	if(!assetCache) {
+		goto _exit;
+	}
+	if(assetStats.asset_count) {
+		evictingKeys = AGE_MALLOC_N(Str, assetStats.asset_count);
+		evictingCount = 0;
+		evictingAll = _all;
+		ht_foreach(assetCache, _collect_evictable_asset);
+		for(i = 0; i < evictingCount; ++i) {
+			/* sprites still using an evicted asset keep it alive */
+			ht_get(assetCache, evictingKeys[i], &fs);
+			ht_remove(assetCache, evictingKeys[i]);
+			--assetStats.asset_count;
+			assetStats.byte_count -= fs->size;
+			_release_frame_set(fs);
+			AGE_FREE(evictingKeys[i]);
+		}
+		result = evictingCount;
+		AGE_FREE_N(evictingKeys);
+		evictingCount = 0;
+		evictingAll = FALSE;
+	}
+	if(_all) {
+		ht_destroy(assetCache);
+		assetCache = 0;
+	}
+
+_exit:
+	return result;
+}
+
+void get_sprite_asset_stats(SpriteAssetStats* _stats) {
+	assert(_stats);
+
+	*_stats = assetStats;
+}
+
+AssetLoading* load_sprite_assets_async(Canvas* _cvs, const Str _manifest, asset_loaded_callback_func _cb) {
+	AssetLoading* result = 0;
+	AssetLoadingJob* job = 0;
+	FILE* fp = 0;
+	SYSTEM_INFO si;
+	s8 buf[AGE_STR_LEN];
+	s8 name[AGE_STR_LEN];
+	s8 shape[AGE_STR_LEN];
+	s8 brush[AGE_STR_LEN];
+	s8 palete[AGE_STR_LEN];
+	Str bs = buf;
+	s32 pending = 0;
+	s32 n = 0;
+	s32 i = 0;
+	s32 k = 0;
+
+	assert(_cvs && _manifest);
 
-	_sprf = _pixelf->parent->parent;
-	_pm = get_sprite_physics_mode(_sprf->owner, _sprf);
+	fp = fopen(_manifest, "rb");
+	if(!fp) {
+		goto _exit;
+	}
+	result = AGE_MALLOC(AssetLoading);
+	result->loaded = _cb;
+	while(!feof(fp)) {
+		freadln(fp, &bs);
+		n = sscanf(buf, "%s %s %s %s", name, shape, brush, palete);
+		if((n != 2 && n != 4) || name[0] == '#') {
+			continue;
+		}
+		result->jobs = AGE_REALLOC_N(AssetLoadingJob, result->jobs, (result->job_count + 1));
+		job = &result->jobs[result->job_count++];
+		memset(job, 0, sizeof(AssetLoadingJob));
+		if(strcmp(name, "-")) {
+			job->sprite_name = copy_string(name);
+		}
+		job->shape_file = copy_string(shape);
+		if(n == 4) {
+			job->brush_file = copy_string(brush);
+			job->palete_file = copy_string(palete);
+		}
+		job->key = _make_asset_key(job->shape_file, job->brush_file, job->palete_file);
+	}
+	fclose(fp);
 
-	/* check */
-	if((_pm & PHYSICS_MODE_CHECKER) != PHYSICS_MODE_NULL) {
-		if(_pixelc->frame_count != 0) {
-			if(_sprf->collided) {
-				_sprf->collided(_sprf->owner, _sprf, _sprf->position.x + _px, _sprf->position.y + _py);
+	/* cached or duplicated assets are not loaded again */
+	for(i = 0; i < result->job_count; ++i) {
+		job = &result->jobs[i];
+		if(assetCache && ht_find(assetCache, job->key)) {
+			job->skipped = TRUE;
+		}
+		for(k = 0; k < i && !job->skipped; ++k) {
+			if(!strcmp(result->jobs[k].key, job->key)) {
+				job->skipped = TRUE;
 			}
 		}
-	}
-	/* fill */
-	if((_pm & PHYSICS_MODE_OBSTACLE) != PHYSICS_MODE_NULL) {
-		if(_pixelc->frame_count < MAX_CACHED_FRAME_COUNT) { /* fill */
-			_pixelc->owner_frames[
-				_pixelc->frame_count++
-			] = _pixelf->parent;
-			result = TRUE;
+		if(!job->skipped) {
+			++pending;
 		}
-		for(i = 0; i < _pixelc->frame_count; ++i) { /* check */
-			_sprc = _pixelc->owner_frames[i]->parent;
-			if(_sprf != _sprc && _sprc->collided) {
-				_sprc->collided(_sprc->owner, _sprc, _sprf->position.x + _px, _sprf->position.y + _py);
+	}
+
+	/* one worker per core, each takes the next unloaded entry */
+	GetSystemInfo(&si);
+	result->worker_count = (s32)si.dwNumberOfProcessors < pending ? (s32)si.dwNumberOfProcessors : pending;
+	result->event = CreateEvent(0, FALSE, FALSE, 0);
+	if(result->worker_count) {
+		result->workers = AGE_MALLOC_N(HANDLE, result->worker_count);
+		for(i = 0; i < result->worker_count; ++i) {
+			result->workers[i] = CreateThread(0, 0, _asset_loading_proc, result, 0, 0);
+			if(!result->workers[i]) {
+				break;
 			}
 		}
+		result->worker_count = i;
+	}
+	if(pending && !result->worker_count) {
+		/* no worker could be started, load on the calling thread instead, published while updating as usual */
+		_asset_loading_proc(result);
 	}
 
+	result->next = _cvs->loadings;
+	_cvs->loadings = result;
+
+_exit:
 	return result;
 }
 
-Canvas* create_canvas(const Str _name) {
-	s32 count = CANVAS_WIDTH * CANVAS_HEIGHT;
-	Str name = copy_string(_name);
-	Canvas* result = AGE_MALLOC(Canvas);
+bl get_asset_loading_progress(AssetLoading* _loading, s32* _loaded, s32* _total) {
+	assert(_loading);
 
-	result->name = name;
-	result->params = create_paramset();
-	result->size.w = CANVAS_WIDTH;
-	result->size.h = CANVAS_HEIGHT;
-	result->pixels = AGE_MALLOC_N(Pixel, count);
-	result->sprites = ht_create(0, ht_cmp_string, ht_hash_string, 0);
-	result->context.last_color = ERASE_PIXEL_COLOR;
-	create_canvas_message_map(result);
+	if(_loaded) {
+		*_loaded = _loading->published_count;
+	}
+	if(_total) {
+		*_total = _loading->job_count;
+	}
 
-	return result;
+	return _loading->published_count == _loading->job_count;
 }
 
-void destroy_canvas(Canvas* _cvs) {
-	s32 i = 0;
-	Sprite* spr = 0;
+void wait_asset_loading(Canvas* _cvs, AssetLoading* _loading) {
+	bl publishing = FALSE;
 
-	destroy_canvas_message_map(_cvs);
-	destroy_paramset(_cvs->params);
-	destroy_all_sprites(_cvs);
+	assert(_cvs && _loading);
 
-	for(i = 0; i < _cvs->dropped_sprites_count; ++i) {
-		spr = _cvs->dropped_sprites[i];
-		_destroy_sprite_impl(_cvs, spr);
+	publishing = _cvs->publishing_loadings;
+	_cvs->publishing_loadings = TRUE;
+	_publish_asset_loading(_cvs, _loading);
+	while(_loading->published_count < _loading->job_count && !_loading->destroyed) {
+		WaitForSingleObject(_loading->event, INFINITE);
+		_publish_asset_loading(_cvs, _loading);
 	}
-	AGE_FREE_N(_cvs->dropped_sprites);
-	_cvs->dropped_sprites_size = 0;
-	_cvs->dropped_sprites_count = 0;
+	_cvs->publishing_loadings = publishing;
+	if(!publishing) {
+		_sweep_asset_loadings(_cvs);
+	}
+}
 
-	ht_destroy(_cvs->sprites);
+void detach_asset_loading(Canvas* _cvs, AssetLoading* _loading) {
+	assert(_cvs && _loading);
 
-	AGE_FREE_N(_cvs->pixels);
-	AGE_FREE(_cvs->name);
-	AGE_FREE(_cvs);
+	_loading->detached = TRUE;
 }
 
-void set_frame_rate(Canvas* _cvs, s32 _rate) {
-	assert(_cvs && _rate > 0);
+void destroy_asset_loading(Canvas* _cvs, AssetLoading* _loading) {
+	AssetLoading** l = 0;
 
-	_cvs->frame_rate = _rate;
+	assert(_cvs && _loading);
+
+	if(_cvs->publishing_loadings) {
+		/* a loaded callback is running, stop publishing and free it when publishing is done */
+		InterlockedExchange(&_loading->cancelled, TRUE);
+		_loading->destroyed = TRUE;
+
+		return;
+	}
+	for(l = &_cvs->loadings; *l; l = &(*l)->next) {
+		if(*l == _loading) {
+			*l = _loading->next;
+			break;
+		}
+	}
+	_free_asset_loading(_loading);
 }
 
-s32 get_frame_rate(Canvas* _cvs) {
+void destroy_sprite(Canvas* _cvs, Sprite* _spr) {
+	ls_node_t* spr = 0;
+	SpriteInstance* inst = 0;
+	s32 i = 0;
+
 	assert(_cvs);
 
-	return _cvs->frame_rate;
+	spr = ht_find(_cvs->sprites, _spr->name);
+	if(spr) {
+		tobeRemoved = (Sprite*)spr->data;
+		ht_foreach(_cvs->sprites, _on_removing_sprite);
+		tobeRemoved = 0;
+
+		ht_remove(_cvs->sprites, spr->extra);
+		_remove_render_list(_cvs, _spr);
+		/* its pixels are left, but sprites under them are no longer clean */
+		if(_spr->drawn && _spr->instances) {
+			for(i = 0; i < _spr->instances->count; ++i) {
+				inst = &_spr->instances->instances[i];
+				if(inst->drawn_frame != INVALID_FRAME_INDEX) {
+					_damage_view(_cvs, inst->drawn_position.x, inst->drawn_position.y, _spr->frame_size.w, _spr->frame_size.h);
+				}
+			}
+		} else if(_spr->drawn) {
+			_damage_view(_cvs, _spr->drawn_position.x, _spr->drawn_position.y, _spr->frame_size.w, _spr->frame_size.h);
+		}
+		_drop_sprite(_cvs, _spr);
+	}
 }
 
-void collide_canvas(Canvas* _cvs, s32 _elapsedTime) {
-	ht_foreach(_cvs->sprites, _collide_sprite);
+void destroy_all_sprites(Canvas* _cvs) {
+	assert(_cvs);
+
+	ht_foreach(_cvs->sprites, _destroy_sprite);
+	ht_clear(_cvs->sprites);
+	_cvs->render_list_count = 0;
 }
 
-void update_canvas(Canvas* _cvs, s32 _elapsedTime) {
-	control_proc ctrl = 0;
+Color get_sprite_pixel_color(Canvas* _cvs, Sprite* _spr, s32 _frame, s32 _x, s32 _y) {
+	Color result = ERASE_PIXEL_COLOR;
+	Frame* frame = 0;
 
-	_cvs->context.last_elapsed_time = _elapsedTime;
-	_cvs->context.last_lparam = 0;
-	_cvs->context.last_wparam = 0;
-	_cvs->context.last_extra = 0;
+	assert(_cvs && _spr);
 
-	ctrl = get_canvas_controller(_cvs);
-	if(ctrl) {
-		ctrl(_cvs, _cvs->name, _elapsedTime, 0, 0, 0);
+	if(_frame < 0 || _frame > _spr->time_line.frame_count - 1) {
+		goto _exit;
 	}
+	frame = &_spr->time_line.frames[_frame];
 
-	ht_foreach(_cvs->sprites, _update_sprite);
+	if(_x < 0 || _x > _spr->frame_size.w - 1 || _y < 0 || _y > _spr->frame_size.h - 1) {
+		goto _exit;
+	}
+
+	result = frame->tex[_x + _y * _spr->frame_size.w].color;
+
+_exit:
+	return result;
 }
 
-void tidy_canvas(Canvas* _cvs, s32 _elapsedTime) {
-	Sprite* spr = 0;
+void set_sprite_pixel_color(Canvas* _cvs, Sprite* _spr, s32 _frame, s32 _x, s32 _y, Color _col) {
+	Frame* frame = 0;
+
+	assert(_cvs && _spr);
+
+	if(_frame < 0 || _frame > _spr->time_line.frame_count - 1) {
+		goto _exit;
+	}
+	if(_x < 0 || _x > _spr->frame_size.w - 1 || _y < 0 || _y > _spr->frame_size.h - 1) {
+		goto _exit;
+	}
+
+	_unshare_frame_set(_spr);
+	frame = &_spr->time_line.frames[_frame];
+	frame->tex[_x + _y * _spr->frame_size.w].color = _col;
+	_spr->dirty = TRUE;
+
+_exit:
+	return;
+}
+
+void fill_sprite_pixels(Canvas* _cvs, Sprite* _spr, s32 _frame, s32 _x, s32 _y, s32 _w, s32 _h, Color _col) {
+	Texel* row = 0;
 	s32 i = 0;
+	s32 j = 0;
 
-	for(i = 0; i < _cvs->dropped_sprites_count; ++i) {
-		spr = _cvs->dropped_sprites[i];
-		_destroy_sprite_impl(_cvs, spr);
+	assert(_cvs && _spr);
+
+	if(!_clip_sprite_rect(_spr, _frame, &_x, &_y, &_w, &_h)) {
+		return;
 	}
-	if(_cvs->dropped_sprites_size - _cvs->dropped_sprites_count > 16) {
-		AGE_FREE_N(_cvs->dropped_sprites);
-		_cvs->dropped_sprites_size = 0;
+	_unshare_frame_set(_spr);
+	row = &_spr->time_line.frames[_frame].tex[_x + _y * _spr->frame_size.w];
+	for(j = 0; j < _h; ++j, row += _spr->frame_size.w) {
+		for(i = 0; i < _w; ++i) {
+			row[i].color = _col;
+		}
 	}
-	_cvs->dropped_sprites_count = 0;
+	_spr->dirty = TRUE;
 }
 
-void render_canvas(Canvas* _cvs, s32 _elapsedTime) {
-	s32 x = 0;
-	s32 y = 0;
-	Pixel* pixelc = 0;
+void replace_sprite_pixels(Canvas* _cvs, Sprite* _spr, s32 _frame, s32 _x, s32 _y, s32 _w, s32 _h, Color _from, Color _to) {
+	Texel* row = 0;
+	s32 i = 0;
+	s32 j = 0;
 
-	/* fill frame buffer */
-	if(_cvs->prev_render) {
-		_cvs->prev_render(_cvs, _elapsedTime);
+	assert(_cvs && _spr);
+
+	if(!_clip_sprite_rect(_spr, _frame, &_x, &_y, &_w, &_h)) {
+		return;
 	}
-	ht_foreach(_cvs->sprites, _fire_render_sprite);
-	{
-		s32 i = 0;
-		s32 j = 0;
-		for(i = 0; i < _cvs->size.w; ++i) {
-			for(j = 0; j < _cvs->size.h; ++j) {
-				Pixel* pc = &_cvs->pixels[i + j * _cvs->size.w];
-				pc->frame_count = 0;
+	_unshare_frame_set(_spr);
+	row = &_spr->time_line.frames[_frame].tex[_x + _y * _spr->frame_size.w];
+	for(j = 0; j < _h; ++j, row += _spr->frame_size.w) {
+		for(i = 0; i < _w; ++i) {
+			if(row[i].color == _from) {
+				row[i].color = _to;
 			}
 		}
 	}
-	ht_foreach(_cvs->sprites, _post_render_sprite);
-	if(_cvs->post_render) {
-		_cvs->post_render(_cvs, _elapsedTime);
-	}
+	_spr->dirty = TRUE;
+}
 
-	/* render frame buffer to target */
-	for(y = 0; y < _cvs->size.h; ++y) {
-		for(x = 0; x < _cvs->size.w; ++x) {
-			pixelc = &_cvs->pixels[x + y * _cvs->size.w];
-			if(pixelc->color == ERASE_PIXEL_COLOR) {
-				set_color(_cvs, get_mapped_color(0));
-				goto_xy(_cvs, x, y);
-				putch(ERASE_PIXEL_SHAPE);
-				pixelc->color = 0;
-			} else if(pixelc->shape) {
-				set_color(_cvs, pixelc->color);
-				goto_xy(_cvs, x, y);
-				putch(pixelc->shape);
-			}
+void copy_sprite_pixels(Canvas* _cvs, Sprite* _tgt, s32 _tgtFrame, s32 _x, s32 _y, Sprite* _src, s32 _srcFrame, s32 _srcX, s32 _srcY, s32 _w, s32 _h) {
+	Texel* tgt = 0;
+	const Texel* src = 0;
+	s32 j = 0;
+	s32 sx = _srcX;
+	s32 sy = _srcY;
+	s32 x = 0;
+	s32 y = 0;
+
+	assert(_cvs && _tgt && _src);
+
+	/* clip to source, shift target by the clipped amount, then clip to target and shift source back */
+	if(!_clip_sprite_rect(_src, _srcFrame, &sx, &sy, &_w, &_h)) {
+		return;
+	}
+	_x += sx - _srcX;
+	_y += sy - _srcY;
+	x = _x;
+	y = _y;
+	if(!_clip_sprite_rect(_tgt, _tgtFrame, &x, &y, &_w, &_h)) {
+		return;
+	}
+	sx += x - _x;
+	sy += y - _y;
+	_unshare_frame_set(_tgt);
+	tgt = &_tgt->time_line.frames[_tgtFrame].tex[x + y * _tgt->frame_size.w];
+	src = &_src->time_line.frames[_srcFrame].tex[sx + sy * _src->frame_size.w];
+	/* rows overlap only when copying inside a frame, where both pointers are in the same texels */
+	if(_tgt->time_line.frames[_tgtFrame].tex == _src->time_line.frames[_srcFrame].tex && tgt > src) {
+		tgt += (_h - 1) * _tgt->frame_size.w;
+		src += (_h - 1) * _src->frame_size.w;
+		for(j = 0; j < _h; ++j, tgt -= _tgt->frame_size.w, src -= _src->frame_size.w) {
+			memmove(tgt, src, sizeof(Texel) * _w);
+		}
+	} else {
+		for(j = 0; j < _h; ++j, tgt += _tgt->frame_size.w, src += _src->frame_size.w) {
+			memmove(tgt, src, sizeof(Texel) * _w);
 		}
 	}
+	_recompile_frame(_tgt, _tgtFrame);
+	_tgt->dirty = TRUE;
 }
 
-Sprite* get_sprite_by_name(Canvas* _cvs, const Str _name) {
-	Sprite* result = 0;
+void upload_sprite_frame(Canvas* _cvs, Sprite* _spr, s32 _frame, const s8* _shapes, const Color* _colors) {
+	Texel* tex = 0;
+	s32 i = 0;
+	s32 n = 0;
 
-	assert(_cvs);
+	assert(_cvs && _spr);
 
-	ht_get(_cvs->sprites, _name, &result);
+	if(_frame < 0 || _frame > _spr->time_line.frame_count - 1 || (!_shapes && !_colors)) {
+		return;
+	}
+	_unshare_frame_set(_spr);
+	tex = _spr->time_line.frames[_frame].tex;
+	n = _spr->frame_size.w * _spr->frame_size.h;
+	if(_shapes) {
+		for(i = 0; i < n; ++i) {
+			tex[i].shape = _shapes[i];
+		}
+	}
+	if(_colors) {
+		for(i = 0; i < n; ++i) {
+			tex[i].color = _colors[i];
+		}
+	}
+	if(_shapes) {
+		_recompile_frame(_spr, _frame);
+	}
+	_spr->dirty = TRUE;
+}
 
-	return result;
+void set_sprite_color_remap(Canvas* _cvs, Sprite* _spr, Color _from, Color _to) {
+	s32 i = 0;
+
+	assert(_cvs && _spr);
+
+	if(_from >= (Color)TINT_REMAP_SIZE) {
+		return;
+	}
+	if(!_spr->tint.remap) {
+		_spr->tint.remap = AGE_MALLOC_N(Color, TINT_REMAP_SIZE);
+		for(i = 0; i < TINT_REMAP_SIZE; ++i) {
+			_spr->tint.remap[i] = (Color)i;
+		}
+	}
+	_spr->tint.remap[_from] = _to;
+	_spr->dirty = TRUE;
 }
 
-Sprite* create_sprite(Canvas* _cvs, const Str _name, const Str _shapeFile, const Str _brushFile, const Str _paleteFile) {
-	Sprite* result = 0;
-	ht_node_t* sprites = 0;
+void set_sprite_tint(Canvas* _cvs, Sprite* _spr, Color _col) {
+	assert(_cvs && _spr);
 
-	assert(_cvs);
+	if(_spr->tint.color != _col) {
+		_spr->tint.color = _col;
+		_spr->dirty = TRUE;
+	}
+}
 
-	if(!get_sprite_by_name(_cvs, _name)) {
-		result = AGE_MALLOC(Sprite);
-		result->name = copy_string(_name);
-		result->visibility = VISIBILITY_VISIBLE;
-		result->params = create_paramset();
-		result->owner = _cvs;
-		result->time_line.named_frames = ht_create(0, ht_cmp_string, ht_hash_string, _destroy_string);
+void set_sprite_gradient(Canvas* _cvs, Sprite* _spr, s32 _dx, s32 _dy, s32 _count) {
+	s32 i = 0;
 
-		_create_sprite_shape(_cvs, result, _shapeFile);
-		_create_sprite_brush(_cvs, result, _brushFile);
-		_create_sprite_palete(_cvs, result, _paleteFile);
+	assert(_cvs && _spr && _count >= 0);
+
+	if(_spr->tint.gradient) {
+		AGE_FREE_N(_spr->tint.gradient);
+	}
+	if(_count) {
+		_spr->tint.gradient = AGE_MALLOC_N(Color, _count);
+		for(i = 0; i < _count; ++i) {
+			_spr->tint.gradient[i] = NO_TINT_COLOR;
+		}
+	}
+	_spr->tint.gradient_count = _count;
+	_spr->tint.gradient_step.x = _dx;
+	_spr->tint.gradient_step.y = _dy;
+	_spr->dirty = TRUE;
+}
 
-		create_sprite_message_map(result);
+void set_sprite_gradient_color(Canvas* _cvs, Sprite* _spr, s32 _index, Color _col) {
+	assert(_cvs && _spr);
 
-		sprites = _cvs->sprites;
-		ht_set_or_insert(sprites, result->name, result);
+	if(_index < 0 || _index >= _spr->tint.gradient_count) {
+		return;
+	}
+	if(_spr->tint.gradient[_index] != _col) {
+		_spr->tint.gradient[_index] = _col;
+		_spr->dirty = TRUE;
 	}
+}
 
-	return result;
+void clear_sprite_tint(Canvas* _cvs, Sprite* _spr) {
+	assert(_cvs && _spr);
+
+	if(_is_sprite_tinted(_spr)) {
+		_spr->dirty = TRUE;
+	}
+	if(_spr->tint.remap) {
+		AGE_FREE_N(_spr->tint.remap);
+	}
+	if(_spr->tint.gradient) {
+		AGE_FREE_N(_spr->tint.gradient);
+	}
+	_spr->tint.color = NO_TINT_COLOR;
+	_spr->tint.gradient_count = 0;
 }
 
-Sprite* clone_sprite(Canvas* _cvs, const Str _srcName, const Str _tgtName) {
-	Sprite* result = 0;
-	Sprite* src = 0;
+SpriteInstanceSet* create_sprite_instances(Canvas* _cvs, Sprite* _spr, instance_collision_callback_func _cb) {
+	SpriteInstanceSet* result = 0;
 
-	src = get_sprite_by_name(_cvs, _srcName);
-	result = get_sprite_by_name(_cvs, _tgtName);
-	assert(src && !result);
-	if(src && !result) {
-		/* TODO: copy from memory, not from file */
-		result = create_sprite(
-			_cvs,
-			_tgtName,
-			src->time_line.shape_file_name,
-			src->time_line.brush_file_name,
-			src->time_line.palete_file_name
-		);
-		result->physics_mode = src->physics_mode;
-		result->collided = src->collided;
-		result->control = src->control;
-		result->object_removed = src->object_removed;
-		result->update = src->update;
-		result->prev_render = src->prev_render;
-		result->post_render = src->post_render;
-		copy_message_map(&src->message_map, &result->message_map);
-	} else {
-		result = 0;
+	assert(_cvs && _spr);
+
+	if(!_spr->instances) {
+		/* the sprite itself is no longer drawn */
+		if(_spr->drawn) {
+			_damage_view(_cvs, _spr->drawn_position.x, _spr->drawn_position.y, _spr->frame_size.w, _spr->frame_size.h);
+			_erase_frame_spans(_cvs, _spr, INVALID_FRAME_INDEX, &_spr->time_line.frames[_spr->drawn_frame], &_spr->drawn_position);
+			_spr->drawn = FALSE;
+		}
+		_spr->instances = AGE_MALLOC(SpriteInstanceSet);
 	}
+	result = _spr->instances;
+	result->collided = _cb;
 
 	return result;
 }
 
-void destroy_sprite(Canvas* _cvs, Sprite* _spr) {
-	ls_node_t* spr = 0;
-
-	assert(_cvs);
+s32 add_sprite_instance(Canvas* _cvs, Sprite* _spr, s32 _x, s32 _y, s32 _frame) {
+	s32 result = 0;
+	SpriteInstanceSet* set = 0;
+	SpriteInstance* inst = 0;
 
-	spr = ht_find(_cvs->sprites, _spr->name);
-	if(spr) {
-		tobeRemoved = (Sprite*)spr->data;
-		ht_foreach(_cvs->sprites, _on_removing_sprite);
-		tobeRemoved = 0;
+	assert(_cvs && _spr && _spr->instances);
+	assert(_frame >= 0 && _frame < _spr->time_line.frame_count);
 
-		ht_remove(_cvs->sprites, spr->extra);
-		_drop_sprite(_cvs, _spr);
+	set = _spr->instances;
+	if(set->count + 1 > set->size) {
+		set->size = set->size ? set->size * 2 : 16;
+		set->instances = AGE_REALLOC_N(SpriteInstance, set->instances, set->size);
 	}
+	result = set->count++;
+	inst = &set->instances[result];
+	memset(inst, 0, sizeof(SpriteInstance));
+	inst->position.x = _x;
+	inst->position.y = _y;
+	inst->frame = _frame;
+	inst->drawn_frame = INVALID_FRAME_INDEX;
+	inst->visible = TRUE;
+	set->changed = TRUE;
+
+	return result;
 }
 
-void destroy_all_sprites(Canvas* _cvs) {
-	assert(_cvs);
+void remove_sprite_instance(Canvas* _cvs, Sprite* _spr, s32 _index) {
+	SpriteInstanceSet* set = 0;
 
-	ht_foreach(_cvs->sprites, _destroy_sprite);
-	ht_clear(_cvs->sprites);
+	assert(_cvs && _spr && _spr->instances);
+
+	set = _spr->instances;
+	if(_index < 0 || _index >= set->count) {
+		return;
+	}
+	_erase_sprite_instance(_cvs, _spr, _index);
+	set->instances[_index] = set->instances[--set->count];
+	set->changed = TRUE;
 }
 
-Color get_sprite_pixel_color(Canvas* _cvs, Sprite* _spr, s32 _frame, s32 _x, s32 _y) {
-	Color result = ERASE_PIXEL_COLOR;
-	Frame* frame = 0;
+void set_sprite_instance(Canvas* _cvs, Sprite* _spr, s32 _index, s32 _x, s32 _y, s32 _frame, bl _vis) {
+	SpriteInstance* inst = 0;
 
-	assert(_cvs && _spr);
+	assert(_cvs && _spr && _spr->instances);
+	assert(_frame >= 0 && _frame < _spr->time_line.frame_count);
 
-	if(_frame < 0 || _frame > _spr->time_line.frame_count - 1) {
-		goto _exit;
+	inst = get_sprite_instance(_cvs, _spr, _index);
+	if(!inst) {
+		return;
 	}
-	frame = &_spr->time_line.frames[_frame];
-
-	if(_x < 0 || _x > _spr->frame_size.w - 1 || _y < 0 || _y > _spr->frame_size.h - 1) {
-		goto _exit;
+	if(inst->position.x != _x || inst->position.y != _y || inst->frame != _frame || inst->visible != _vis) {
+		inst->position.x = _x;
+		inst->position.y = _y;
+		inst->frame = _frame;
+		inst->visible = _vis;
+		_spr->instances->changed = TRUE;
 	}
+}
 
-	result = frame->tex[_x + _y * _spr->frame_size.w].color;
+SpriteInstance* get_sprite_instance(Canvas* _cvs, Sprite* _spr, s32 _index) {
+	SpriteInstance* result = 0;
+
+	assert(_cvs && _spr);
+
+	if(_spr->instances && _index >= 0 && _index < _spr->instances->count) {
+		result = &_spr->instances->instances[_index];
+	}
 
-_exit:
 	return result;
 }
 
-void set_sprite_pixel_color(Canvas* _cvs, Sprite* _spr, s32 _frame, s32 _x, s32 _y, Color _col) {
-	Frame* frame = 0;
+s32 get_sprite_instance_count(Canvas* _cvs, Sprite* _spr) {
+	s32 result = 0;
 
 	assert(_cvs && _spr);
 
-	if(_frame < 0 || _frame > _spr->time_line.frame_count - 1) {
-		goto _exit;
-	}
-	frame = &_spr->time_line.frames[_frame];
-
-	if(_x < 0 || _x > _spr->frame_size.w - 1 || _y < 0 || _y > _spr->frame_size.h - 1) {
-		goto _exit;
+	if(_spr->instances) {
+		result = _spr->instances->count;
 	}
 
-	frame->tex[_x + _y * _spr->frame_size.w].color = _col;
-
-_exit:
-	return;
+	return result;
 }
 
 bl set_sprite_visible(Canvas* _cvs, Sprite* _spr, bl _vis) {
@@ -693,6 +3637,31 @@ bl get_sprite_position(Canvas* _cvs, Sprite* _spr, s32* _x, s32* _y) {
 	return result;
 }
 
+bl set_sprite_zorder(Canvas* _cvs, Sprite* _spr, s32 _zorder) {
+	bl result = TRUE;
+
+	assert(_cvs && _spr);
+
+	if(_spr->zorder != _zorder) {
+		_remove_render_list(_cvs, _spr);
+		_spr->zorder = _zorder;
+		_spr->dirty = TRUE;
+		_insert_render_list(_cvs, _spr);
+	}
+
+	return result;
+}
+
+s32 get_sprite_zorder(Canvas* _cvs, Sprite* _spr) {
+	s32 result = DEFAULT_Z_ORDER;
+
+	assert(_cvs && _spr);
+
+	result = _spr->zorder;
+
+	return result;
+}
+
 s32 get_named_frame_index(Canvas* _cvs, Sprite* _spr, const Str _name) {
 	s32 result = INVALID_FRAME_INDEX;
 	ls_node_t* n = 0;
@@ -800,132 +3769,109 @@ void update_sprite(Canvas* _cvs, Sprite* _spr, s32 _elapsedTime) {
 }
 
 void prev_render_sprite(Canvas* _cvs, Sprite* _spr, s32 _elapsedTime) {
-	s32 i = 0;
-	s32 j = 0;
-	s32 k = 0;
-	s32 x = 0;
-	s32 y = 0;
-	s32 s = 0;
-	s32 itf = 0;
-	s32 found = INVALID_FRAME_INDEX;
-	Pixel* pixelf = 0;
-	Pixel* pixelc = 0;
+	Frame* frame = 0;
+	Point pos;
 
 	if(_spr->visibility == VISIBILITY_HIDEN) {
 		return;
 	}
+	if(_spr->instances) {
+		_prev_render_instances(_cvs, _spr);
+	}
 	if(_spr->visibility == VISIBILITY_DISAPPEARING) {
 		_spr->visibility = VISIBILITY_HIDEN;
 	}
-	k = _spr->time_line.last_frame;
-	for(j = 0; j < _spr->frame_size.h; ++j) {
-		y = _spr->old_position.y + j;
-		if(y < 0 || y >= _cvs->size.h) {
-			continue;
-		}
-		for(i = 0; i < _spr->frame_size.w; ++i) {
-			x = _spr->old_position.x + i;
-			if(x < 0 || x >= _cvs->size.w) {
-				continue;
-			}
-			pixelf = &_spr->time_line.frames[k].tex[i + j * _spr->frame_size.w];
-			pixelc = &_cvs->pixels[x + y * _cvs->size.w];
-			s = (s32)pixelf->shape;
-			if(s) {
-				pixelc->shape = 0;
-				pixelc->color = ERASE_PIXEL_COLOR;
-				pixelc->zorder = DEFAULT_Z_ORDER;
-				found = INVALID_FRAME_INDEX;
-				for(itf = 0; itf < pixelc->frame_count; ++itf) {
-					if(pixelc->owner_frames[itf] == pixelf->parent) {
-						found = itf;
-						pixelc->owner_frames[found] =
-							pixelc->owner_frames[
-								--pixelc->frame_count
-							];
-					}
-				}
-			}
-		}
+	if(_spr->instances) {
+		goto _exit;
 	}
+	frame = &_spr->time_line.frames[_spr->time_line.last_frame];
+	pos.x = _spr->old_position.x - _cvs->last_camera.x;
+	pos.y = _spr->old_position.y - _cvs->last_camera.y;
+	if(!_is_sprite_in_view(_cvs, _spr, &pos)) {
+		goto _exit;
+	}
+	/* pixels of a clean sprite are left in frame buffer as they are */
+	if(!_is_sprite_dirty(_cvs, _spr)) {
+		goto _exit;
+	}
+	_damage_view(_cvs, pos.x, pos.y, _spr->frame_size.w, _spr->frame_size.h);
+	_erase_frame_spans(_cvs, _spr, INVALID_FRAME_INDEX, frame, &pos);
+
+_exit:
 	_spr->last_frame_position = _spr->old_position;
 	_spr->old_position = _spr->position;
 }
 
 void post_render_sprite(Canvas* _cvs, Sprite* _spr, s32 _elapsedTime) {
-	s32 i = 0;
-	s32 j = 0;
 	s32 k = 0;
-	s32 x = 0;
-	s32 y = 0;
-	s32 s = 0;
-	Pixel* pixelf = 0;
-	Pixel* pixelc = 0;
+	Frame* frame = 0;
+	Point pos;
 
 	if(_spr->visibility != VISIBILITY_VISIBLE) {
+		_spr->drawn = FALSE;
+
+		return;
+	}
+	if(_spr->instances) {
+		_post_render_instances(_cvs, _spr);
+
 		return;
 	}
 	_spr->time_line.last_frame = _spr->time_line.current_frame;
 	k = _spr->time_line.current_frame;
-	for(j = 0; j < _spr->frame_size.h; ++j) {
-		y = _spr->position.y + j;
-		if(y < 0 || y >= _cvs->size.h) {
-			continue;
-		}
-		for(i = 0; i < _spr->frame_size.w; ++i) {
-			x = _spr->position.x + i;
-			if(x < 0 || x >= _cvs->size.w) {
-				continue;
-			}
-			pixelf = &_spr->time_line.frames[k].tex[i + j * _spr->frame_size.w];
-			pixelc = &_cvs->pixels[x + y * _cvs->size.w];
-			s = (s32)pixelf->shape;
-			if(s != ERASE_PIXEL_SHAPE) {
-				if(pixelf->zorder <= pixelc->zorder) {
-					pixelc->shape = (s8)s;
-					pixelc->color = pixelf->color;
-					pixelc->zorder = pixelf->zorder;
-				}
-			}
-		}
+	frame = &_spr->time_line.frames[k];
+	pos.x = _spr->position.x - _cvs->camera.x;
+	pos.y = _spr->position.y - _cvs->camera.y;
+	if(!_is_sprite_in_view(_cvs, _spr, &pos)) {
+		_spr->drawn = FALSE;
+
+		return;
+	}
+	/* a clean sprite is redrawn only if erasing or drawing others damaged its area */
+	if(!_is_sprite_dirty(_cvs, _spr) && !_is_view_damaged(_cvs, pos.x, pos.y, _spr->frame_size.w, _spr->frame_size.h)) {
+		return;
 	}
+	_damage_view(_cvs, pos.x, pos.y, _spr->frame_size.w, _spr->frame_size.h);
+	_spr->dirty = FALSE;
+	_spr->drawn = TRUE;
+	_spr->drawn_position = pos;
+	_spr->drawn_frame = k;
+	_draw_frame_spans(_cvs, _spr, frame, &pos, _is_sprite_tinted(_spr));
 }
 
 void collide_sprite(Canvas* _cvs, Sprite* _spr, s32 _elapsedTime) {
-	s32 i = 0;
-	s32 j = 0;
-	s32 k = 0;
-	s32 x = 0;
-	s32 y = 0;
-	s32 s = 0;
-	Pixel* pixelf = 0;
-	Pixel* pixelc = 0;
+	Frame* frame = 0;
+	Point pos;
 
 	if(_spr->visibility != VISIBILITY_VISIBLE) {
 		return;
 	}
+	if(_spr->instances) {
+		_collide_instances(_cvs, _spr);
+
+		return;
+	}
 	_spr->time_line.last_frame = _spr->time_line.current_frame;
-	k = _spr->time_line.current_frame;
-	for(j = 0; j < _spr->frame_size.h; ++j) {
-		y = _spr->position.y + j;
-		if(y < 0 || y >= _cvs->size.h) {
-			continue;
-		}
-		for(i = 0; i < _spr->frame_size.w; ++i) {
-			x = _spr->position.x + i;
-			if(x < 0 || x >= _cvs->size.w) {
-				continue;
-			}
-			pixelf = &_spr->time_line.frames[k].tex[i + j * _spr->frame_size.w];
-			pixelc = &_cvs->pixels[x + y * _cvs->size.w];
-			s = (s32)pixelf->shape;
-			if(s != ERASE_PIXEL_SHAPE) {
-				_try_fill_pixel_collision(pixelc, pixelf, i, j);
-			} else if(pixelf->brush != ERASE_PIXEL_SHAPE) {
-				_try_fill_pixel_collision(pixelc, pixelf, i, j);
-			}
-		}
+	if(!_spr->touched) {
+		return;
+	}
+	frame = &_spr->time_line.frames[_spr->time_line.current_frame];
+	pos.x = _spr->position.x - _cvs->camera.x;
+	pos.y = _spr->position.y - _cvs->camera.y;
+	if(!_is_sprite_in_view(_cvs, _spr, &pos)) {
+		return;
 	}
+	_collide_frame_spans(_cvs, _spr, INVALID_FRAME_INDEX, frame, &pos, &_spr->position);
+}
+
+bl test_sprite_overlap(Canvas* _cvs, Sprite* _spr1, Sprite* _spr2, CollisionContact* _contact) {
+	assert(_cvs && _spr1 && _spr2);
+
+	return _test_frame_overlap(
+		_spr1, _spr1->time_line.current_frame, &_spr1->position,
+		_spr2, _spr2->time_line.current_frame, &_spr2->position,
+		_contact
+	);
 }
 
 u32 get_sprite_physics_mode(Canvas* _cvs, Sprite* _spr) {
@@ -944,90 +3890,323 @@ void draw_string(Canvas* _cvs, Font* _font, s32 _x, s32 _y, const Str _text, ...
 	s8 buf[AGE_TXT_LEN];
 	Str pbuf = buf;
 	va_list argptr;
-	goto_xy(_cvs, _x, _y);
-	if(_font) {
-		set_color(_cvs, _font->color);
-	} else {
-		set_color(_cvs, get_mapped_color(15));
-	}
 	va_start(argptr, _text);
 	vsprintf(pbuf, _text, argptr);
 	va_end(argptr);
-	printf(buf);
+	_set_text_string(_cvs, _x, _y, buf, _font ? _font->color : get_mapped_color(15));
 }
 
 void put_char(Canvas* _cvs, Font* _font, s32 _x, s32 _y, s8 _ch) {
-	goto_xy(_cvs, _x, _y);
-	if(_font) {
-		set_color(_cvs, _font->color);
-	} else {
-		set_color(_cvs, get_mapped_color(15));
+	_set_text_pixel(_cvs, _x, _y, _ch, _font ? _font->color : get_mapped_color(15));
+}
+
+void clear_text(Canvas* _cvs) {
+	s32 x = 0;
+	s32 y = 0;
+
+	assert(_cvs);
+
+	for(y = 0; y < _cvs->view_size.h; ++y) {
+		for(x = 0; x < _cvs->view_size.w; ++x) {
+			_set_text_pixel(_cvs, x, y, 0, 0);
+		}
+	}
+}
+
+void set_text_zorder(Canvas* _cvs, s32 _zorder) {
+	assert(_cvs);
+
+	_cvs->text_zorder = _zorder;
+}
+
+s32 get_text_zorder(Canvas* _cvs) {
+	s32 result = 0;
+
+	assert(_cvs);
+
+	result = _cvs->text_zorder;
+
+	return result;
+}
+
+void set_background_pixel(Canvas* _cvs, s32 _x, s32 _y, s8 _shape, Color _col) {
+	Pixel* pixelb = 0;
+	Pixel* pixelc = 0;
+
+	assert(_cvs);
+
+	if(_x < 0 || _x >= _cvs->view_size.w || _y < 0 || _y >= _cvs->view_size.h) {
+		return;
+	}
+	pixelb = &_cvs->background[_x + _y * _cvs->view_size.w];
+	if(pixelb->shape == _shape && pixelb->color == _col) {
+		return;
+	}
+	pixelb->shape = _shape;
+	pixelb->color = _col;
+	/* damage this pixel unless a sprite covers it, it will be revealed when the sprite is erased */
+	pixelc = &_cvs->pixels[_x + _y * _cvs->view_size.w];
+	if(!pixelc->shape) {
+		pixelc->color = ERASE_PIXEL_COLOR;
+	}
+}
+
+bl get_background_pixel(Canvas* _cvs, s32 _x, s32 _y, s8* _shape, Color* _col) {
+	bl result = FALSE;
+	Pixel* pixelb = 0;
+
+	assert(_cvs);
+
+	if(_x < 0 || _x >= _cvs->view_size.w || _y < 0 || _y >= _cvs->view_size.h) {
+		goto _exit;
+	}
+	pixelb = &_cvs->background[_x + _y * _cvs->view_size.w];
+	if(_shape) {
+		*_shape = pixelb->shape;
+	}
+	if(_col) {
+		*_col = pixelb->color;
+	}
+	result = TRUE;
+
+_exit:
+	return result;
+}
+
+void clear_background(Canvas* _cvs) {
+	s32 x = 0;
+	s32 y = 0;
+
+	assert(_cvs);
+
+	for(y = 0; y < _cvs->view_size.h; ++y) {
+		for(x = 0; x < _cvs->view_size.w; ++x) {
+			set_background_pixel(_cvs, x, y, 0, 0);
+		}
 	}
-	putch(_ch);
 }
 
 Color get_mapped_color(s32 _index) {
 	Color result = ERASE_PIXEL_COLOR;
 
-	assert(_index >= 0 && _index < sizeof(COLOR_MAP));
+	assert(_index >= 0 && _index < _countof(COLOR_MAP));
 
 	result = COLOR_MAP[_index];
 
 	return result;
 }
 
+u32 make_rgb_channel(u8 _r, u8 _g, u8 _b) {
+	return COLOR_CHANNEL_RGB | ((u32)_r << 16) | ((u32)_g << 8) | (u32)_b;
+}
+
+Color make_color(u32 _fg, u32 _bg) {
+	Color result = COLOR_EXTENDED;
+
+	if(_fg & COLOR_CHANNEL_RGB) {
+		result |= COLOR_EXTENDED_RGB | (_fg & 0xFFFFFF) | (_nearest_console_color(_bg) << 24);
+	} else if(_bg & COLOR_CHANNEL_RGB) {
+		result |= COLOR_EXTENDED_RGB | COLOR_EXTENDED_RGB_BG | (_bg & 0xFFFFFF) | (_nearest_console_color(_fg) << 24);
+	} else {
+		result |= (_fg & 0xFF) | ((_bg & 0xFF) << 8);
+	}
+
+	return result;
+}
+
+u32 get_color_channel(Color _col, bl _bg) {
+	u32 result = 0;
+	u32 attr = 0;
+
+	if(_col & COLOR_EXTENDED) {
+		if(!(_col & COLOR_EXTENDED_RGB)) {
+			result = (_bg ? (_col >> 8) : _col) & 0xFF;
+		} else if(!_bg == !(_col & COLOR_EXTENDED_RGB_BG)) {
+			result = COLOR_CHANNEL_RGB | (_col & 0xFFFFFF);
+		} else {
+			result = (_col >> 24) & 0x0F;
+		}
+	} else {
+		attr = (_bg ? (_col >> 4) : _col) & 0x0F;
+		result = _swap_red_blue(attr & 7) | (attr & 8);
+	}
+
+	return result;
+}
+
+#if AGE_IMPL == AGE_IMPL_HEADLESS
 void set_cursor_visible(Canvas* _cvs, bl _vis) {
-	HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+	/* do nothing */
+}
+
+void goto_xy(Canvas* _cvs, s32 _x, s32 _y) {
+	_enter_output(_cvs);
+	_cvs->context.last_position.x = _x;
+	_cvs->context.last_position.y = _y;
+	_leave_output(_cvs);
+}
+
+void set_color(Canvas* _cvs, Color _col) {
+	_enter_output(_cvs);
+	_cvs->context.last_color = _col;
+	_leave_output(_cvs);
+}
+
+u32 get_render_target_hash(Canvas* _cvs) {
+	u32 result = 0;
+
+	assert(_cvs && _cvs->target);
+
+	_enter_output(_cvs);
+	result = ((HeadlessTarget*)_cvs->target)->hash;
+	_leave_output(_cvs);
+
+	return result;
+}
+
+void dump_render_target(Canvas* _cvs, FILE* _fp, bl _withColor) {
+	HeadlessTarget* tgt = 0;
+	s32 x = 0;
+	s32 y = 0;
+
+	assert(_cvs && _cvs->target && _fp);
+
+	_enter_output(_cvs);
+	tgt = (HeadlessTarget*)_cvs->target;
+	for(y = 0; y < _cvs->view_size.h; ++y) {
+		fwrite(&tgt->shapes[y * _cvs->view_size.w], 1, _cvs->view_size.w, _fp);
+		fputc('\n', _fp);
+	}
+	if(_withColor) {
+		for(y = 0; y < _cvs->view_size.h; ++y) {
+			for(x = 0; x < _cvs->view_size.w; ++x) {
+				fprintf(_fp, "%02x", (u32)(tgt->colors[x + y * _cvs->view_size.w] & 0xFF));
+			}
+			fputc('\n', _fp);
+		}
+	}
+	_leave_output(_cvs);
+}
+#else
+void set_cursor_visible(Canvas* _cvs, bl _vis) {
+	HANDLE hOut = 0;
 	CONSOLE_CURSOR_INFO cci;
-	GetConsoleCursorInfo(hOut, &cci);
-	cci.bVisible = _vis;
-	SetConsoleCursorInfo(hOut, &cci);
+	const Str seq = _vis ? "\x1b[?25h" : "\x1b[?25l";
+	_enter_output(_cvs);
+	if(_cvs->stream.enabled) {
+		_write_stream(_cvs, seq, (s32)strlen(seq));
+	} else {
+		hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+		GetConsoleCursorInfo(hOut, &cci);
+		cci.bVisible = _vis;
+		SetConsoleCursorInfo(hOut, &cci);
+	}
+	_leave_output(_cvs);
 }
 
 void goto_xy(Canvas* _cvs, s32 _x, s32 _y) {
-	HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+	s8 buf[AGE_STR_LEN];
 	COORD pos;
-	pos.X = _x;
-	pos.Y = _y;
-	SetConsoleCursorPosition(hOut, pos);
+	_enter_output(_cvs);
+	if(_x != _cvs->context.last_position.x || _y != _cvs->context.last_position.y) {
+		if(_cvs->stream.enabled) {
+			sprintf(buf, "\x1b[%d;%dH", _y + 1, _x + 1);
+			_write_stream(_cvs, buf, (s32)strlen(buf));
+		} else {
+			pos.X = _x;
+			pos.Y = _y;
+			SetConsoleCursorPosition(GetStdHandle(STD_OUTPUT_HANDLE), pos);
+		}
+		_cvs->context.last_position.x = _x;
+		_cvs->context.last_position.y = _y;
+	}
+	_leave_output(_cvs);
+}
+
+static WORD _console_attribute(Color _col) {
+	WORD result = 0;
+	u32 fg = 0;
+	u32 bg = 0;
+
+	if(_col & COLOR_EXTENDED) {
+		fg = _nearest_console_color(get_color_channel(_col, FALSE));
+		bg = _nearest_console_color(get_color_channel(_col, TRUE));
+		result = (WORD)((_swap_red_blue(fg & 7) | (fg & 8)) | ((_swap_red_blue(bg & 7) | (bg & 8)) << 4));
+	} else {
+		result = (WORD)_col;
+	}
+
+	return result;
+}
+
+static void _write_color_sgr(Canvas* _cvs, Color _col) {
+	s8 buf[AGE_STR_LEN];
+	s32 len = 0;
+	bl unknown = FALSE;
+	u32 fg = 0;
+	u32 bg = 0;
+
+	/* foreground and background are tracked separately, only changed ones are emitted */
+	unknown = _cvs->context.last_color == ERASE_PIXEL_COLOR;
+	fg = _canonical_channel(get_color_channel(_col, FALSE));
+	bg = _canonical_channel(get_color_channel(_col, TRUE));
+	len = sprintf(buf, "\x1b[");
+	if(unknown || fg != _canonical_channel(get_color_channel(_cvs->context.last_color, FALSE))) {
+		len += _format_channel_sgr(buf + len, fg, FALSE);
+	}
+	if(unknown || bg != _canonical_channel(get_color_channel(_cvs->context.last_color, TRUE))) {
+		if(len > 2) {
+			buf[len++] = ';';
+		}
+		len += _format_channel_sgr(buf + len, bg, TRUE);
+	}
+	if(len > 2) {
+		buf[len++] = 'm';
+		_write_stream(_cvs, buf, len);
+	}
 }
 
 void set_color(Canvas* _cvs, Color _col) {
-	HANDLE hConsole;
+	_enter_output(_cvs);
 	if(_col != _cvs->context.last_color) {
-		hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-		SetConsoleTextAttribute(hConsole, get_mapped_color(_col));
+		if(_cvs->stream.enabled) {
+			_write_color_sgr(_cvs, _col);
+		} else {
+			SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), _console_attribute(_col));
+		}
 		_cvs->context.last_color = _col;
 	}
+	_leave_output(_cvs);
 }
+#endif
 
 void clear_pixel(Canvas* _cvs, s32 _x, s32 _y) {
 	Pixel* pixelc = 0;
 
-	pixelc = &_cvs->pixels[_x + _y * _cvs->size.w];
+	pixelc = &_cvs->pixels[_x + _y * _cvs->view_size.w];
 
-	set_color(_cvs, get_mapped_color(0));
-	goto_xy(_cvs, _x, _y);
-	putch(ERASE_PIXEL_SHAPE);
+	/* it will be erased in next presenting */
 	pixelc->shape = 0;
-	pixelc->brush = ERASE_PIXEL_SHAPE;
-	pixelc->color = 0;
-	pixelc->frame_count = 0;
-	pixelc->parent = 0;
-	pixelc->zorder = DEFAULT_Z_ORDER;
+	pixelc->color = ERASE_PIXEL_COLOR;
+	_cvs->background[_x + _y * _cvs->view_size.w].shape = 0;
+	_cvs->background[_x + _y * _cvs->view_size.w].color = 0;
+	_cvs->texts[_x + _y * _cvs->view_size.w].shape = 0;
+	_cvs->texts[_x + _y * _cvs->view_size.w].color = 0;
+	_get_pixel_owners(_cvs, _x + _y * _cvs->view_size.w)->owner_count = 0;
+	_damage_view(_cvs, _x, _y, 1, 1);
 }
 
 void clear_screen(Canvas* _cvs) {
 	s32 x = 0;
 	s32 y = 0;
 
-	for(y = 0; y < _cvs->size.h; ++y) {
-		for(x = 0; x < _cvs->size.w; ++x) {
+	for(y = 0; y < _cvs->view_size.h; ++y) {
+		for(x = 0; x < _cvs->view_size.w; ++x) {
 			clear_pixel(_cvs, x, y);
 		}
 	}
 
-	system("cls");
+	((Presenter*)_cvs->presenter)->clear = TRUE;
 }
 
-#endif /* AGE_IMPL == AGE_IMPL_CONSOLE */
+#endif /* AGE_IMPL == AGE_IMPL_CONSOLE || AGE_IMPL == AGE_IMPL_HEADLESS */
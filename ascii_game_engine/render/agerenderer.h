@@ -35,7 +35,7 @@
 #include "../message/agemessage.h"
 #include "../controller/agecontroller.h"
 
-#define MAX_CACHED_FRAME_COUNT 16
+#define COLLISION_MASK_STRIDE(_w) (((_w) + 63) / 64)
 
 /**
  * @brief visible visibility
@@ -56,14 +56,50 @@ static const s32 VISIBILITY_HIDEN = 0;
 static const s8 NAMED_FRAME_PREFIX = '@';
 
 /**
- * @brief default z-order
+ * @brief default z-order, sprites with smaller z-order are drawn in front
  */
 static const s32 DEFAULT_Z_ORDER = 0x0FFFFFFF;
 
 /**
- * @brief color used for erase a pixel
+ * @brief color used for erase a pixel, outside both the classic and the extended ranges
  */
-static const Color ERASE_PIXEL_COLOR = -1;
+static const Color ERASE_PIXEL_COLOR = 0x7FFFFFFF;
+
+/**
+ * @brief flag of an extended color value
+ *
+ * @note a color value without this flag is a classic console attribute, foreground
+ *       in bits 0-3 and background in bits 4-7; with this flag and without
+ *       COLOR_EXTENDED_RGB, foreground is a 256-color index in bits 0-7 and background
+ *       in bits 8-15, see make_color
+ */
+static const Color COLOR_EXTENDED = (Color)1 << 31;
+
+/**
+ * @brief flag of an extended color value with a 24-bit RGB channel in bits 0-23,
+ *        the other channel is a 16-color index in bits 24-27
+ */
+static const Color COLOR_EXTENDED_RGB = (Color)1 << 30;
+
+/**
+ * @brief flag of an extended RGB color value whose RGB channel is the background
+ */
+static const Color COLOR_EXTENDED_RGB_BG = (Color)1 << 29;
+
+/**
+ * @brief tag of a 24-bit RGB color channel, a channel without this tag is a 256-color index
+ */
+static const u32 COLOR_CHANNEL_RGB = 1 << 24;
+
+/**
+ * @brief color meaning no recoloring in a sprite tint, outside both the classic and the extended ranges
+ */
+static const Color NO_TINT_COLOR = 0x7FFFFFFE;
+
+/**
+ * @brief entries count of a sprite color remap table, indexed by classic console attributes
+ */
+static const s32 TINT_REMAP_SIZE = 256;
 
 /**
  * @brief shape used for erase a pixel
@@ -90,6 +126,11 @@ static const u32 PHYSICS_MODE_OBSTACLE = (1 << 0);
  */
 static const u32 PHYSICS_MODE_CHECKER = (1 << 1);
 
+/**
+ * @brief cell size of broad phase collision grid, in pixels
+ */
+static const s32 COLLISION_GRID_CELL_SIZE = 8;
+
 /**
  * @brief font structure
  */
@@ -99,38 +140,116 @@ typedef struct Font {
 
 struct Frame;
 struct Sprite;
+struct SpriteContact;
 struct Canvas;
+struct Recorder;
+struct Playback;
+struct AssetLoading;
+struct OwnerChunk;
 
 /**
- * @brief pixel structure
+ * @brief texel structure, a pixel of a sprite frame
+ */
+typedef struct Texel {
+	Color color; /**< color value */
+	s8 shape;    /**< shape data */
+	s8 brush;    /**< brush data, used with palete to paint a pixel */
+} Texel;
+
+/**
+ * @brief pixel structure, a pixel of canvas frame buffer
  */
 typedef struct Pixel {
-	/* common */
-	struct Frame* parent; /**< parent frame object */
-	s8 shape;             /**< shape data */
-	Color color;          /**< color value */
-	s32 zorder;           /**< z-order of this pixel */
-	union {
-		/* for sprite frame */
-		struct {
-			s8 brush;     /**< brush data, used with palete to paint a pixel */
-		};
-		/* for canvas frame buffer */
-		struct {
-			struct Frame* owner_frames[MAX_CACHED_FRAME_COUNT]; /**< owner frames */
-			s32 frame_count;                                    /**< owner frames count */
-		};
-	};
+	Color color; /**< color value */
+	s32 zorder;  /**< z-order of the sprite drawn on this pixel */
+	s8 shape;    /**< shape data */
 } Pixel;
 
+/**
+ * @brief pixel owner structure, a sprite or an instance of it filling a pixel of canvas collision plane
+ */
+typedef struct PixelOwner {
+	struct Sprite* sprite; /**< owner sprite */
+	s32 index;             /**< instance index of owner sprite, or INVALID_FRAME_INDEX for the sprite itself */
+} PixelOwner;
+
+/**
+ * @brief pixel owners structure, a pixel of canvas collision plane
+ */
+typedef struct PixelOwners {
+	PixelOwner* owners; /**< owner sprites and instances, allocated in owner arena of canvas */
+	s32 owner_count;    /**< owners count */
+	s32 owner_size;     /**< owners buffer size */
+	u32 stamp;          /**< owner stamp of canvas when filled, owners of an older stamp are stale */
+} PixelOwners;
+
+/**
+ * @brief presented pixel structure, keeps what has been output to the render target
+ */
+typedef struct PresentedPixel {
+	s8 shape;    /**< presented shape, 0 for unknown */
+	Color color; /**< presented color value */
+} PresentedPixel;
+
+/**
+ * @brief span structure, a run of continuous texels in a frame row
+ */
+typedef struct Span {
+	s32 x;   /**< begin column in frame */
+	s32 y;   /**< row in frame */
+	s32 len; /**< texels count */
+} Span;
+
+/**
+ * @brief span list structure, row ordered spans of a frame
+ */
+typedef struct SpanList {
+	Span* spans; /**< spans */
+	s32 count;   /**< spans count */
+} SpanList;
+
 /**
  * @brief frame structure
  */
 typedef struct Frame {
-	struct Sprite* parent; /**< parent sprite object */
-	Pixel* tex;            /**< pixels */
+	Texel* tex;             /**< texels */
+	SpanList draw_spans;    /**< spans of texels to be drawn */
+	SpanList erase_spans;   /**< spans of texels to be erased */
+	SpanList collide_spans; /**< spans of texels to be collided */
+	u64* mask;              /**< collision mask, one bit per collided texel, rows of FrameSet::mask_stride words */
+	Span* own_spans;        /**< spans recompiled after the frame is edited, allocated apart from frame set */
 } Frame;
 
+/**
+ * @brief frame set structure, frame data loaded from shape, brush and palete files
+ *
+ * @note a frame set is one contiguous block, frames, texels of all frames, collision
+ *       masks and spans follow this header; it is shared by a sprite and its clones, and copied
+ *       before a sharing sprite writes to it
+ */
+typedef struct FrameSet {
+	s32 ref_count;           /**< reference count */
+	s32 size;                /**< block size in bytes */
+	Size frame_size;         /**< frame size */
+	f32 frame_rate;          /**< frame rate */
+	Frame* frames;           /**< all frames */
+	s32 frame_count;         /**< frames count */
+	s32 mask_stride;         /**< words count of a collision mask row */
+	ht_node_t* named_frames; /**< named frame information */
+	bl pinned;               /**< whether pinned in sprite asset cache */
+	Ptr mapped_view;         /**< mapped compiled asset file which texels and spans point into, or 0 */
+} FrameSet;
+
+/**
+ * @brief sprite asset cache statistics structure
+ */
+typedef struct SpriteAssetStats {
+	u32 hit_count;   /**< lookups served from cache */
+	u32 miss_count;  /**< lookups loaded from files */
+	s32 asset_count; /**< cached assets count */
+	s32 byte_count;  /**< cached frame data size in bytes */
+} SpriteAssetStats;
+
 /**
  * @brief sprite playing event callback functor
  *
@@ -150,11 +269,12 @@ typedef struct TimeLine {
 	Str shape_file_name;                   /**< shape file name */
 	Str brush_file_name;                   /**< brush file name */
 	Str palete_file_name;                  /**< palete file name */
-	Frame* frames;                         /**< all frames */
+	FrameSet* frame_set;                   /**< frame data, may be shared with cloned sprites */
+	Frame* frames;                         /**< all frames, points into frame set */
 	s32 frame_count;                       /**< frames count */
 	s32 current_frame;                     /**< current frame index */
 	s32 last_frame;                        /**< last frame index */
-	ht_node_t* named_frames;               /**< named frame information */
+	ht_node_t* named_frames;               /**< named frame information, points into frame set */
 	Str begin_name;                        /**< begin frame name */
 	Str end_name;                          /**< end frame name */
 	s32 begin_index;                       /**< begin frame index */
@@ -190,6 +310,26 @@ typedef void (* sprite_removing_callback_func)(Ptr _handlerObj, struct Canvas* _
  * @param[in] _py  - y position of collided pixel in sprite
  */
 typedef void (* sprite_collision_callback_func)(struct Canvas* _cvs, struct Sprite* _spr, s32 _px, s32 _py);
+/**
+ * @brief sprite instance collision callback functor
+ *
+ * @param[in] _cvs   - canvas object
+ * @param[in] _spr   - instanced sprite object
+ * @param[in] _index - index of collided instance
+ * @param[in] _px    - x position of collided pixel
+ * @param[in] _py    - y position of collided pixel
+ */
+typedef void (* instance_collision_callback_func)(struct Canvas* _cvs, struct Sprite* _spr, s32 _index, s32 _px, s32 _py);
+
+/**
+ * @brief sprite contact callback functor, called once for each touching sprite pair in a frame,
+ *        a checker sprite is called for each obstacle sprite touching it
+ *
+ * @param[in] _cvs     - canvas object
+ * @param[in] _spr     - sprite object
+ * @param[in] _contact - contact with another sprite
+ */
+typedef void (* sprite_contact_callback_func)(struct Canvas* _cvs, struct Sprite* _spr, const struct SpriteContact* _contact);
 
 /**
  * @brief sprite updating functor
@@ -216,6 +356,44 @@ typedef void (* sprite_render_func)(struct Canvas* _cvs, struct Sprite* _spr, s3
  */
 typedef void (* sprite_collide_func)(struct Canvas* _cvs, struct Sprite* _spr, s32 _elapsedTime);
 
+/**
+ * @brief sprite tint structure, recolors texels while drawing a sprite
+ *
+ * @note a gradient color overrides the tint color, which overrides a remapped color
+ */
+typedef struct SpriteTint {
+	Color* remap;         /**< color remap table of TINT_REMAP_SIZE entries, or 0 */
+	Color color;          /**< color of all texels, or NO_TINT_COLOR */
+	Color* gradient;      /**< gradient colors indexed by x * step.x + y * step.y, NO_TINT_COLOR entries are skipped */
+	s32 gradient_count;   /**< gradient colors count */
+	Point gradient_step;  /**< gradient index step of a column and a row */
+} SpriteTint;
+
+/**
+ * @brief sprite instance structure, a lightweight sprite drawn with frame set of its instanced sprite
+ */
+typedef struct SpriteInstance {
+	Point position;       /**< position */
+	Point drawn_position; /**< view position of last drawing */
+	s32 frame;            /**< current frame index */
+	s32 drawn_frame;      /**< frame index of last drawing, INVALID_FRAME_INDEX if not drawn */
+	bl visible;           /**< visible or not */
+	bl touched;           /**< whether its bounding box overlaps another one in broad phase of colliding */
+	Ptr userdata;         /**< user defined data, not destroyed by engine */
+} SpriteInstance;
+
+/**
+ * @brief sprite instance set structure, all instances share z-order, physics mode and tint of their sprite
+ */
+typedef struct SpriteInstanceSet {
+	SpriteInstance* instances;                 /**< instances array */
+	s32 count;                                 /**< instances count */
+	s32 size;                                  /**< instances array size */
+	bl changed;                                /**< whether any instance was moved, animated or hidden since last drawing */
+	Rect drawn_bounds;                         /**< view bounds of last drawing */
+	instance_collision_callback_func collided; /**< collided physics callback, not called if the sprite is a checker with contact callback */
+} SpriteInstanceSet;
+
 /**
  * @brief user defined data
  */
@@ -231,6 +409,7 @@ typedef struct Sprite {
 	struct Canvas* owner;                         /**< owner canvas object */
 	Str name;                                     /**< name */
 	s32 visibility;                               /**< visibility */
+	s32 zorder;                                   /**< z-order */
 	AgeParamSet* params;                          /**< parameter set */
 	bl store_params;                              /**< whether store parameters to saved data file or not */
 	Userdata userdata;                            /**< user defined data */
@@ -245,15 +424,62 @@ typedef struct Sprite {
 	s32 frame_tick;                               /**< frame updating time tick count */
 	sprite_removing_callback_func object_removed; /**< sprite removing callback */
 	u32 physics_mode;                             /**< physics mode */
-	sprite_collision_callback_func collided;      /**< collided physics callback */
+	sprite_collision_callback_func collided;      /**< collided physics callback, called for each collided texel unless contacted is set on a checker */
+	sprite_contact_callback_func contacted;       /**< contact callback of a checker, called for each touching obstacle instead of collided */
 	MessageMap message_map;                       /**< message processing map */
 	control_proc control;                         /**< controlling functor, for motion controlling */
 	sprite_update_func update;                    /**< updating functor, for animation controlling */
 	sprite_render_func prev_render;               /**< fire rendering functor */
 	sprite_render_func post_render;               /**< post rendering functor */
 	sprite_collide_func collide;                  /**< colliding functor */
+	bl dirty;                                     /**< whether to be redrawn for a change other than moving, animating or hiding */
+	bl drawn;                                     /**< whether its pixels are left in frame buffer by last drawing */
+	Point drawn_position;                         /**< view position of last drawing */
+	s32 drawn_frame;                              /**< frame index of last drawing */
+	SpriteTint tint;                              /**< recoloring applied while drawing, frame data is left untouched */
+	SpriteInstanceSet* instances;                 /**< instances drawn in place of this sprite, or 0 */
+	bl touched;                                   /**< whether its bounding box overlaps another one in broad phase of colliding */
 } Sprite;
 
+/**
+ * @brief collision contact structure, overlapping texels of two collision masks
+ */
+typedef struct CollisionContact {
+	s32 count;   /**< overlapping texels count */
+	Rect bounds; /**< bounding box of overlapping texels, in world */
+	Point first; /**< first overlapping texel in row order, in world */
+} CollisionContact;
+
+/**
+ * @brief sprite contact structure, overlapping of a sprite pair in a frame
+ */
+typedef struct SpriteContact {
+	Sprite* sprite;           /**< sprite object */
+	s32 index;                /**< instance index of sprite, or INVALID_FRAME_INDEX */
+	Sprite* other;            /**< the other sprite object */
+	s32 other_index;          /**< instance index of the other sprite, or INVALID_FRAME_INDEX */
+	CollisionContact contact; /**< overlapping texels */
+} SpriteContact;
+
+/**
+ * @brief collision proxy structure, bounding box of a sprite or an instance in broad phase of colliding
+ */
+typedef struct CollisionProxy {
+	Sprite* sprite; /**< sprite object */
+	s32 index;      /**< instance index, or INVALID_FRAME_INDEX for the sprite itself */
+	Rect box;       /**< bounding box in viewport */
+} CollisionProxy;
+
+/**
+ * @brief output stream structure, collects output bytes of a frame to write them at once
+ */
+typedef struct OutputStream {
+	s8* data;     /**< buffered bytes */
+	s32 size;     /**< used bytes count */
+	s32 capacity; /**< buffer size in bytes */
+	bl enabled;   /**< TRUE if output goes through VT sequences instead of console calls */
+} OutputStream;
+
 /**
  * @brief running context structure
  */
@@ -263,6 +489,7 @@ typedef struct RunningContext {
 	u32 last_wparam;       /**< second param of last message */
 	Ptr last_extra;        /**< extra user defined data of last message */
 	Color last_color;      /**< color value since last draw call */
+	Point last_position;   /**< cursor position since last draw call, negative for unknown */
 } RunningContext;
 
 /**
@@ -273,6 +500,16 @@ typedef struct RunningContext {
  */
 typedef void (* canvas_render_func)(struct Canvas* _cvs, s32 _elapsedTime);
 
+/**
+ * @brief asynchronous asset loading callback functor, called when an entry is published
+ *
+ * @param[in] _cvs    - canvas object
+ * @param[in] _spr    - created sprite object, or 0 for a preloading entry or a duplicated name
+ * @param[in] _loaded - count of published entries
+ * @param[in] _total  - count of all entries
+ */
+typedef void (* asset_loaded_callback_func)(struct Canvas* _cvs, struct Sprite* _spr, s32 _loaded, s32 _total);
+
 /**
  * @brief canvas structure
  */
@@ -280,9 +517,42 @@ typedef struct Canvas {
 	Str name;                       /**< name */
 	AgeParamSet* params;            /**< parameter set */
 	bl store_params;                /**< whether store parameters to saved data file or not */
-	Size size;                      /**< canvas size */
-	Pixel* pixels;                  /**< frame buffer */
+	Size size;                      /**< canvas size, size of the world */
+	Size view_size;                 /**< viewport size, size of frame buffer and collision plane */
+	Point camera;                   /**< camera position, left top corner of viewport in world */
+	Point last_camera;              /**< camera position of last rendering */
+	Pixel* pixels;                  /**< frame buffer, covers viewport */
+	Pixel* background;              /**< background layer, composited under sprites, covers viewport */
+	Pixel* texts;                   /**< retained text layer, covers viewport */
+	s32 text_zorder;                /**< z-order of text layer */
+	PixelOwners* owners;            /**< collision plane, owner sprites and instances of each pixel in viewport */
+	struct OwnerChunk* owner_arena; /**< frame scoped arena of owner sprites, chunks are reset at once in each rendering */
+	struct OwnerChunk* owner_chunk; /**< owner arena chunk being allocated from */
+	u32 owner_stamp;                /**< stamp of current collision plane */
+	Ptr presenter;                  /**< presenter context, composes and presents snapshots of frame buffer, owns front buffer and presenting counters */
+	u32 dropped_frame_count;        /**< count of frames dropped before presenting, used with AGE_PRESENTER_THREAD */
+	OutputStream stream;            /**< output stream, enabled with AGE_VT_OUTPUT where the console accepts it */
+	Ptr target;                     /**< in-memory render target, used with AGE_IMPL_HEADLESS */
+	struct Recorder* recorder;      /**< frame recorder, records every composed frame if set and sized as viewport, not owned by canvas */
+	struct AssetLoading* loadings;  /**< asynchronous asset loadings, published while updating */
+	bl publishing_loadings;         /**< whether loadings are being published, destroying one is deferred until done */
 	ht_node_t* sprites;             /**< alive sprite objects */
+	Sprite** render_list;           /**< alive sprite objects sorted by z-order, back to front */
+	s32 render_list_count;          /**< render list count */
+	s32 render_list_size;           /**< render list buffer size */
+	Rect* damaged_rects;            /**< view areas damaged since last rendering, clean sprites overlapping them are redrawn */
+	s32 damaged_rects_count;        /**< damaged areas count */
+	s32 damaged_rects_size;         /**< damaged areas buffer size */
+	CollisionProxy* proxies;        /**< bounding boxes of colliding sprites and instances */
+	s32 proxies_count;              /**< collision proxies count */
+	s32 proxies_size;               /**< collision proxies buffer size */
+	Size grid_size;                 /**< broad phase collision grid size, in cells */
+	s32* grid_cells;                /**< first grid entry of each cell, one more than cells count */
+	s32* grid_entries;              /**< collision proxy indices sorted by cell */
+	s32 grid_entries_size;          /**< grid entries buffer size */
+	SpriteContact* contacts;        /**< contacts of last colliding, delivered after pixels are collided */
+	s32 contacts_count;             /**< contacts count */
+	s32 contacts_size;              /**< contacts buffer size */
 	s32 frame_rate;                 /**< canvas frame rate, in millisecond */
 	RunningContext context;         /**< running context */
 	Sprite** dropped_sprites;       /**< dropped sprites */
@@ -298,9 +568,11 @@ typedef struct Canvas {
  * @brief create a canvas object
  *
  * @param[in] _name - canvas name
+ * @param[in] _w    - world width, viewport is up to CANVAS_WIDTH wide
+ * @param[in] _h    - world height, viewport is up to CANVAS_HEIGHT high
  * @return - created canvas object
  */
-AGE_API Canvas* create_canvas(const Str _name);
+AGE_API Canvas* create_canvas(const Str _name, s32 _w, s32 _h);
 /**
  * @brief destroy a canvas object
  *
@@ -324,7 +596,87 @@ AGE_API void set_frame_rate(Canvas* _cvs, s32 _rate);
 AGE_API s32 get_frame_rate(Canvas* _cvs);
 
 /**
- * @brief run collition detection in a canvas
+ * @brief set camera position of a canvas, the camera is clamped inside the world
+ *
+ * @param[in] _cvs - canvas object
+ * @param[in] _x   - x of left top corner of viewport in world
+ * @param[in] _y   - y of left top corner of viewport in world
+ */
+AGE_API void set_canvas_camera(Canvas* _cvs, s32 _x, s32 _y);
+/**
+ * @brief get camera position of a canvas
+ *
+ * @param[in] _cvs - canvas object
+ * @param[out] _x  - pointer to output x
+ * @param[out] _y  - pointer to output y
+ */
+AGE_API void get_canvas_camera(Canvas* _cvs, s32* _x, s32* _y);
+/**
+ * @brief get collision owners of a pixel
+ *
+ * @param[in] _cvs - canvas object
+ * @param[in] _x   - x in world
+ * @param[in] _y   - y in world
+ * @return - pixel owners, or 0 if the pixel is out of viewport
+ *
+ * @note only sprites whose bounding boxes overlap others in last colliding fill the collision plane
+ */
+AGE_API PixelOwners* get_pixel_owners(Canvas* _cvs, s32 _x, s32 _y);
+
+/**
+ * @brief get count of pixels changed in last presenting of a canvas
+ *
+ * @param[in] _cvs - canvas object
+ * @return - changed pixels count
+ */
+AGE_API s32 get_changed_pixel_count(Canvas* _cvs);
+/**
+ * @brief get count of presented frames of a canvas
+ *
+ * @param[in] _cvs - canvas object
+ * @return - presented frames count
+ */
+AGE_API u32 get_presented_frame_count(Canvas* _cvs);
+/**
+ * @brief get count of frames dropped before presenting of a canvas, frames are dropped
+ *        when the presenter thread falls behind, see AGE_PRESENTER_THREAD
+ *
+ * @param[in] _cvs - canvas object
+ * @return - dropped frames count
+ */
+AGE_API u32 get_dropped_frame_count(Canvas* _cvs);
+/**
+ * @brief present last read frame of a playback to a canvas directly, bypasses sprites and layers,
+ *        used to play a recording back on any backend
+ *
+ * @param[in] _cvs - canvas object
+ * @param[in] _pb  - playback object, whose frame size must equal viewport size
+ * @return - return TRUE if succeed, or FALSE if frame size differs from viewport size
+ */
+AGE_API bl present_pixels(Canvas* _cvs, const struct Playback* _pb);
+
+#if AGE_IMPL == AGE_IMPL_HEADLESS
+/**
+ * @brief get hash of the in-memory render target content of a canvas
+ *
+ * @param[in] _cvs - canvas object
+ * @return - hash of all presented characters and colors
+ */
+AGE_API u32 get_render_target_hash(Canvas* _cvs);
+/**
+ * @brief dump the in-memory render target content of a canvas
+ *
+ * @param[in] _cvs       - canvas object
+ * @param[in] _fp        - file to dump to
+ * @param[in] _withColor - whether dump color rows after character rows or not
+ */
+AGE_API void dump_render_target(Canvas* _cvs, FILE* _fp, bl _withColor);
+#endif
+
+/**
+ * @brief run collition detection in a canvas, bounding boxes are tested in a uniform grid first,
+ *        then pixels of sprites and instances touching others are tested, then contacts of
+ *        touching pairs are delivered to contact callbacks
  *
  * @param[in] _cvs         - canvas object
  * @param[in] _elapsedTime - elapsed time since last frame
@@ -371,6 +723,26 @@ AGE_API Sprite* get_sprite_by_name(Canvas* _cvs, const Str _name);
  * @return - created sprite object
  */
 AGE_API Sprite* create_sprite(Canvas* _cvs, const Str _name, const Str _shapeFile, const Str _brushFile, const Str _paleteFile);
+/**
+ * @brief create a sprite object from a compiled asset file, the file is mapped and
+ *        its texels and spans are used in place without parsing
+ *
+ * @param[in] _cvs       - canvas object
+ * @param[in] _name      - sprite name
+ * @param[in] _assetFile - compiled asset file name
+ * @return - created sprite object
+ */
+AGE_API Sprite* create_sprite_from_asset(Canvas* _cvs, const Str _name, const Str _assetFile);
+/**
+ * @brief compile shape, brush and palete files into a binary asset file
+ *
+ * @param[in] _shapeFile  - shape data file name
+ * @param[in] _brushFile  - brush data file name
+ * @param[in] _paleteFile - palete data file name
+ * @param[in] _assetFile  - compiled asset file name to be written
+ * @return - return TRUE if succeed
+ */
+AGE_API bl compile_sprite_asset(const Str _shapeFile, const Str _brushFile, const Str _paleteFile, const Str _assetFile);
 /**
  * @brief create a new sprite object and copy data from an exists sprite object to it
  *
@@ -380,6 +752,86 @@ AGE_API Sprite* create_sprite(Canvas* _cvs, const Str _name, const Str _shapeFil
  * @return - new created target sprite object
  */
 AGE_API Sprite* clone_sprite(Canvas* _cvs, const Str _srcName, const Str _tgtName);
+/**
+ * @brief load a sprite asset into the process-wide asset cache, sprites created from
+ *        cached files share its frame data without touching the file system
+ *
+ * @param[in] _shapeFile  - shape data file name, or compiled asset file name
+ * @param[in] _brushFile  - brush data file name, 0 for a compiled asset
+ * @param[in] _paleteFile - palete data file name, 0 for a compiled asset
+ * @return - return TRUE if the asset has frames
+ */
+AGE_API bl preload_sprite_asset(const Str _shapeFile, const Str _brushFile, const Str _paleteFile);
+/**
+ * @brief pin or unpin a sprite asset in the asset cache, pinned assets are kept while evicting,
+ *        an asset is loaded before pinned if not cached
+ *
+ * @param[in] _shapeFile  - shape data file name, or compiled asset file name
+ * @param[in] _brushFile  - brush data file name, 0 for a compiled asset
+ * @param[in] _paleteFile - palete data file name, 0 for a compiled asset
+ * @param[in] _pin        - pin if TRUE, otherwise unpin
+ * @return - return TRUE if succeed, or FALSE if the asset fails to load or unpinning an uncached asset
+ */
+AGE_API bl pin_sprite_asset(const Str _shapeFile, const Str _brushFile, const Str _paleteFile, bl _pin);
+/**
+ * @brief evict sprite assets from the asset cache
+ *
+ * @param[in] _all - evict all assets if TRUE, otherwise only unpinned ones not used by any sprite
+ * @return - evicted assets count
+ */
+AGE_API s32 evict_sprite_assets(bl _all);
+/**
+ * @brief get statistics of the asset cache
+ *
+ * @param[out] _stats - statistics
+ */
+AGE_API void get_sprite_asset_stats(SpriteAssetStats* _stats);
+/**
+ * @brief load sprite assets listed in a manifest file on a pool of worker threads,
+ *        loaded entries are published to the canvas in manifest order while updating it
+ *
+ * @param[in] _cvs      - canvas object
+ * @param[in] _manifest - manifest file name, each line is "name shape brush palete" or
+ *                        "name asset" for a compiled asset, use "-" as name to preload
+ *                        into the asset cache only, lines beginning with '#' are ignored
+ * @param[in] _cb       - callback when an entry is published, could be 0
+ * @return - asset loading handle, owned by the canvas, or 0 if failed to open the manifest
+ *
+ * @note entries are loaded on the calling thread if no worker thread could be started
+ */
+AGE_API struct AssetLoading* load_sprite_assets_async(Canvas* _cvs, const Str _manifest, asset_loaded_callback_func _cb);
+/**
+ * @brief get progress of an asynchronous asset loading
+ *
+ * @param[in] _loading - asset loading handle
+ * @param[out] _loaded - count of published entries, could be 0 if not needed
+ * @param[out] _total  - count of all entries, could be 0 if not needed
+ * @return - return TRUE if all entries are published
+ */
+AGE_API bl get_asset_loading_progress(struct AssetLoading* _loading, s32* _loaded, s32* _total);
+/**
+ * @brief wait until all entries of an asynchronous asset loading are published
+ *
+ * @param[in] _cvs     - canvas object
+ * @param[in] _loading - asset loading handle
+ */
+AGE_API void wait_asset_loading(Canvas* _cvs, struct AssetLoading* _loading);
+/**
+ * @brief cancel an asynchronous asset loading and destroy its handle, published
+ *        sprites are kept
+ *
+ * @param[in] _cvs     - canvas object
+ * @param[in] _loading - asset loading handle
+ */
+AGE_API void destroy_asset_loading(Canvas* _cvs, struct AssetLoading* _loading);
+/**
+ * @brief give up an asynchronous asset loading handle, the canvas destroys the loading
+ *        once all entries are published, the handle must not be used afterwards
+ *
+ * @param[in] _cvs     - canvas object
+ * @param[in] _loading - asset loading handle
+ */
+AGE_API void detach_asset_loading(Canvas* _cvs, struct AssetLoading* _loading);
 /**
  * @brief destroy a sprite in a canvas
  *
@@ -416,6 +868,163 @@ AGE_API Color get_sprite_pixel_color(Canvas* _cvs, Sprite* _spr, s32 _frame, s32
  * @param[in] _col   - color of the appointed pixel
  */
 AGE_API void set_sprite_pixel_color(Canvas* _cvs, Sprite* _spr, s32 _frame, s32 _x, s32 _y, Color _col);
+/**
+ * @brief fill color of a rectangle of pixels in a sprite, the rectangle is clipped to the frame
+ *
+ * @param[in] _cvs   - canvas object
+ * @param[in] _spr   - sprite object
+ * @param[in] _frame - frame index
+ * @param[in] _x     - x offset of the rectangle
+ * @param[in] _y     - y offset of the rectangle
+ * @param[in] _w     - width of the rectangle
+ * @param[in] _h     - height of the rectangle
+ * @param[in] _col   - color to fill
+ */
+AGE_API void fill_sprite_pixels(Canvas* _cvs, Sprite* _spr, s32 _frame, s32 _x, s32 _y, s32 _w, s32 _h, Color _col);
+/**
+ * @brief replace a color with another in a rectangle of pixels in a sprite, the rectangle
+ *        is clipped to the frame
+ *
+ * @param[in] _cvs   - canvas object
+ * @param[in] _spr   - sprite object
+ * @param[in] _frame - frame index
+ * @param[in] _x     - x offset of the rectangle
+ * @param[in] _y     - y offset of the rectangle
+ * @param[in] _w     - width of the rectangle
+ * @param[in] _h     - height of the rectangle
+ * @param[in] _from  - color to be replaced
+ * @param[in] _to    - color to replace with
+ */
+AGE_API void replace_sprite_pixels(Canvas* _cvs, Sprite* _spr, s32 _frame, s32 _x, s32 _y, s32 _w, s32 _h, Color _from, Color _to);
+/**
+ * @brief copy a rectangle of pixels, shapes and colors, from a sprite frame to another,
+ *        the rectangle is clipped to both frames
+ *
+ * @param[in] _cvs      - canvas object
+ * @param[in] _tgt      - target sprite object
+ * @param[in] _tgtFrame - target frame index
+ * @param[in] _x        - x offset in target frame
+ * @param[in] _y        - y offset in target frame
+ * @param[in] _src      - source sprite object, could be the same as _tgt
+ * @param[in] _srcFrame - source frame index
+ * @param[in] _srcX     - x offset in source frame
+ * @param[in] _srcY     - y offset in source frame
+ * @param[in] _w        - width of the rectangle
+ * @param[in] _h        - height of the rectangle
+ */
+AGE_API void copy_sprite_pixels(Canvas* _cvs, Sprite* _tgt, s32 _tgtFrame, s32 _x, s32 _y, Sprite* _src, s32 _srcFrame, s32 _srcX, s32 _srcY, s32 _w, s32 _h);
+/**
+ * @brief upload shapes and colors of a whole sprite frame from row ordered buffers
+ *
+ * @param[in] _cvs    - canvas object
+ * @param[in] _spr    - sprite object
+ * @param[in] _frame  - frame index
+ * @param[in] _shapes - shapes of frame width * height pixels, 0 to keep shapes
+ * @param[in] _colors - colors of frame width * height pixels, 0 to keep colors
+ */
+AGE_API void upload_sprite_frame(Canvas* _cvs, Sprite* _spr, s32 _frame, const s8* _shapes, const Color* _colors);
+/**
+ * @brief remap a color of a sprite while drawing
+ *
+ * @param[in] _cvs  - canvas object
+ * @param[in] _spr  - sprite object
+ * @param[in] _from - classic console attribute to be remapped, ignored if out of range
+ * @param[in] _to   - color drawn instead
+ */
+AGE_API void set_sprite_color_remap(Canvas* _cvs, Sprite* _spr, Color _from, Color _to);
+/**
+ * @brief set a color to draw all texels of a sprite with
+ *
+ * @param[in] _cvs - canvas object
+ * @param[in] _spr - sprite object
+ * @param[in] _col - tint color, or NO_TINT_COLOR to remove
+ */
+AGE_API void set_sprite_tint(Canvas* _cvs, Sprite* _spr, Color _col);
+/**
+ * @brief set a color gradient of a sprite, texel at (x, y) is drawn with gradient
+ *        color at x * _dx + y * _dy, all colors are NO_TINT_COLOR initially
+ *
+ * @param[in] _cvs   - canvas object
+ * @param[in] _spr   - sprite object
+ * @param[in] _dx    - index step of a column
+ * @param[in] _dy    - index step of a row, e.g. 0, 1 for a per-row gradient
+ * @param[in] _count - gradient colors count, 0 to remove
+ */
+AGE_API void set_sprite_gradient(Canvas* _cvs, Sprite* _spr, s32 _dx, s32 _dy, s32 _count);
+/**
+ * @brief set a color of a sprite gradient
+ *
+ * @param[in] _cvs   - canvas object
+ * @param[in] _spr   - sprite object
+ * @param[in] _index - gradient color index, ignored if out of range
+ * @param[in] _col   - gradient color, or NO_TINT_COLOR to skip
+ */
+AGE_API void set_sprite_gradient_color(Canvas* _cvs, Sprite* _spr, s32 _index, Color _col);
+/**
+ * @brief remove remapping, tint and gradient of a sprite
+ *
+ * @param[in] _cvs - canvas object
+ * @param[in] _spr - sprite object
+ */
+AGE_API void clear_sprite_tint(Canvas* _cvs, Sprite* _spr);
+
+/**
+ * @brief make a sprite instanced, then its instances are drawn and collided in place of itself
+ *
+ * @param[in] _cvs - canvas object
+ * @param[in] _spr - sprite object
+ * @param[in] _cb  - instance collision callback, or 0
+ * @return - instance set of the sprite
+ */
+AGE_API SpriteInstanceSet* create_sprite_instances(Canvas* _cvs, Sprite* _spr, instance_collision_callback_func _cb);
+/**
+ * @brief add an instance to an instanced sprite
+ *
+ * @param[in] _cvs   - canvas object
+ * @param[in] _spr   - instanced sprite object
+ * @param[in] _x     - x position
+ * @param[in] _y     - y position
+ * @param[in] _frame - frame index
+ * @return - index of added instance
+ */
+AGE_API s32 add_sprite_instance(Canvas* _cvs, Sprite* _spr, s32 _x, s32 _y, s32 _frame);
+/**
+ * @brief remove an instance from an instanced sprite, the last instance is moved to its index
+ *
+ * @param[in] _cvs   - canvas object
+ * @param[in] _spr   - instanced sprite object
+ * @param[in] _index - index of instance to be removed
+ */
+AGE_API void remove_sprite_instance(Canvas* _cvs, Sprite* _spr, s32 _index);
+/**
+ * @brief set position, frame and visibility of an instance
+ *
+ * @param[in] _cvs   - canvas object
+ * @param[in] _spr   - instanced sprite object
+ * @param[in] _index - instance index
+ * @param[in] _x     - x position
+ * @param[in] _y     - y position
+ * @param[in] _frame - frame index
+ * @param[in] _vis   - visible or not
+ */
+AGE_API void set_sprite_instance(Canvas* _cvs, Sprite* _spr, s32 _index, s32 _x, s32 _y, s32 _frame, bl _vis);
+/**
+ * @brief get an instance of an instanced sprite, its drawing data must be changed by set_sprite_instance
+ *
+ * @param[in] _cvs   - canvas object
+ * @param[in] _spr   - instanced sprite object
+ * @param[in] _index - instance index
+ * @return - instance, or 0 if out of range
+ */
+AGE_API SpriteInstance* get_sprite_instance(Canvas* _cvs, Sprite* _spr, s32 _index);
+/**
+ * @brief get instances count of an instanced sprite
+ *
+ * @param[in] _cvs - canvas object
+ * @param[in] _spr - sprite object
+ * @return - instances count, 0 if not instanced
+ */
+AGE_API s32 get_sprite_instance_count(Canvas* _cvs, Sprite* _spr);
 
 /**
  * @brief set visibility of a sprite
@@ -457,6 +1066,24 @@ AGE_API bl set_sprite_position(Canvas* _cvs, Sprite* _spr, s32 _x, s32 _y);
  */
 AGE_API bl get_sprite_position(Canvas* _cvs, Sprite* _spr, s32* _x, s32* _y);
 
+/**
+ * @brief set z-order of a sprite, sprites with smaller z-order are drawn in front
+ *
+ * @param[in] _cvs    - canvas object
+ * @param[in] _spr    - sprite object
+ * @param[in] _zorder - z-order
+ * @return - return TRUE if succeed, or FALSE if failed
+ */
+AGE_API bl set_sprite_zorder(Canvas* _cvs, Sprite* _spr, s32 _zorder);
+/**
+ * @brief get z-order of a sprite
+ *
+ * @param[in] _cvs - canvas object
+ * @param[in] _spr - sprite object
+ * @return - z-order
+ */
+AGE_API s32 get_sprite_zorder(Canvas* _cvs, Sprite* _spr);
+
 /**
  * @brief get index of a given named frame
  *
@@ -529,7 +1156,7 @@ AGE_API void prev_render_sprite(Canvas* _cvs, Sprite* _spr, s32 _elapsedTime);
  */
 AGE_API void post_render_sprite(Canvas* _cvs, Sprite* _spr, s32 _elapsedTime);
 /**
- * @brief sprite colliding
+ * @brief sprite colliding, does nothing unless the sprite touches others in broad phase of collide_canvas
  *
  * @param[in] _cvs         - canvas object
  * @param[in] _spr         - sprite object
@@ -537,6 +1164,17 @@ AGE_API void post_render_sprite(Canvas* _cvs, Sprite* _spr, s32 _elapsedTime);
  */
 AGE_API void collide_sprite(Canvas* _cvs, Sprite* _spr, s32 _elapsedTime);
 
+/**
+ * @brief test whether collision masks of current frames of two sprites overlap, 64 texels at a time
+ *
+ * @param[in] _cvs      - canvas object
+ * @param[in] _spr1     - first sprite object
+ * @param[in] _spr2     - second sprite object
+ * @param[out] _contact - overlapping texels count and bounding box, or 0 to return at first overlapping
+ * @return - TRUE if overlapping
+ */
+AGE_API bl test_sprite_overlap(Canvas* _cvs, Sprite* _spr1, Sprite* _spr2, CollisionContact* _contact);
+
 /**
  * @brief get physics mode of a sprite object
  *
@@ -555,7 +1193,8 @@ AGE_API u32 get_sprite_physics_mode(Canvas* _cvs, Sprite* _spr);
 AGE_API void set_sprite_physics_mode(Canvas* _cvs, Sprite* _spr, u32 _mode);
 
 /**
- * @brief draw a string on a canvas
+ * @brief draw a string on the retained text layer of a canvas,
+ *        only changed pixels are presented again
  *
  * @param[in] _cvs  - canvas object
  * @param[in] _font - drawing font
@@ -565,7 +1204,7 @@ AGE_API void set_sprite_physics_mode(Canvas* _cvs, Sprite* _spr, u32 _mode);
  */
 AGE_API void draw_string(Canvas* _cvs, Font* _font, s32 _x, s32 _y, const Str _text, ...);
 /**
- * @brief draw a charactor on a canvas
+ * @brief draw a charactor on the retained text layer of a canvas
  *
  * @param[in] _cvs  - canvas object
  * @param[in] _font - drawing font
@@ -574,6 +1213,56 @@ AGE_API void draw_string(Canvas* _cvs, Font* _font, s32 _x, s32 _y, const Str _t
  * @param[in] _ch   - charactor to draw
  */
 AGE_API void put_char(Canvas* _cvs, Font* _font, s32 _x, s32 _y, s8 _ch);
+/**
+ * @brief clear the retained text layer of a canvas
+ *
+ * @param[in] _cvs - canvas object
+ */
+AGE_API void clear_text(Canvas* _cvs);
+/**
+ * @brief set z-order of the text layer of a canvas, texts are drawn in front of
+ *        sprites with greater or equal z-order
+ *
+ * @param[in] _cvs    - canvas object
+ * @param[in] _zorder - z-order
+ */
+AGE_API void set_text_zorder(Canvas* _cvs, s32 _zorder);
+/**
+ * @brief get z-order of the text layer of a canvas
+ *
+ * @param[in] _cvs - canvas object
+ * @return - z-order
+ */
+AGE_API s32 get_text_zorder(Canvas* _cvs);
+
+/**
+ * @brief set a pixel of the background layer, the layer is composited under sprites
+ *        and only changed pixels of it are presented again
+ *
+ * @param[in] _cvs   - canvas object
+ * @param[in] _x     - x position in screen
+ * @param[in] _y     - y position in screen
+ * @param[in] _shape - shape data, 0 for empty
+ * @param[in] _col   - color value
+ */
+AGE_API void set_background_pixel(Canvas* _cvs, s32 _x, s32 _y, s8 _shape, Color _col);
+/**
+ * @brief get a pixel of the background layer
+ *
+ * @param[in] _cvs    - canvas object
+ * @param[in] _x      - x position in screen
+ * @param[in] _y      - y position in screen
+ * @param[out] _shape - pointer to output shape data
+ * @param[out] _col   - pointer to output color value
+ * @return - return TRUE if succeed, or FALSE if failed
+ */
+AGE_API bl get_background_pixel(Canvas* _cvs, s32 _x, s32 _y, s8* _shape, Color* _col);
+/**
+ * @brief clear the background layer
+ *
+ * @param[in] _cvs - canvas object
+ */
+AGE_API void clear_background(Canvas* _cvs);
 
 /**
  * @brief get a mapped color value
@@ -582,6 +1271,35 @@ AGE_API void put_char(Canvas* _cvs, Font* _font, s32 _x, s32 _y, s8 _ch);
  * @return - mapped color value
  */
 AGE_API Color get_mapped_color(s32 _index);
+/**
+ * @brief make a 24-bit RGB color channel
+ *
+ * @param[in] _r - red component
+ * @param[in] _g - green component
+ * @param[in] _b - blue component
+ * @return - color channel
+ */
+AGE_API u32 make_rgb_channel(u8 _r, u8 _g, u8 _b);
+/**
+ * @brief make an extended color value
+ *
+ * @param[in] _fg - foreground channel, a 256-color index or a channel made by make_rgb_channel
+ * @param[in] _bg - background channel, a 256-color index or a channel made by make_rgb_channel
+ * @return - extended color value
+ *
+ * @note only one channel keeps 24-bit RGB, foreground first, the other one is
+ *       approximated to the nearest of the 16 console colors
+ */
+AGE_API Color make_color(u32 _fg, u32 _bg);
+/**
+ * @brief get a channel of a color value, classic console attributes are converted
+ *        to 256-color indices
+ *
+ * @param[in] _col - color value
+ * @param[in] _bg  - get background channel if TRUE, otherwise foreground channel
+ * @return - color channel
+ */
+AGE_API u32 get_color_channel(Color _col, bl _bg);
 /**
  * @brief set whether the console cursor is visible
  *
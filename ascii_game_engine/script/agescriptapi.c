@@ -203,6 +203,84 @@ int age_api_create_sprite(mb_interpreter_t* s, void** l) {
 	return result;
 }
 
+int age_api_create_sprite_from_asset(mb_interpreter_t* s, void** l) {
+	int result = MB_FUNC_OK;
+	Str name = 0;
+	Str assetFile = 0;
+
+	assert(s && l);
+
+	mb_attempt_open_bracket(s, l);
+	mb_pop_string(s, l, &name);
+	mb_pop_string(s, l, &assetFile);
+	mb_attempt_close_bracket(s, l);
+
+	create_sprite_from_asset(AGE_CVS, name, assetFile);
+
+	return result;
+}
+
+int age_api_compile_sprite_asset(mb_interpreter_t* s, void** l) {
+	int result = MB_FUNC_OK;
+	Str shapeFile = 0;
+	Str brushFile = 0;
+	Str paleteFile = 0;
+	Str assetFile = 0;
+
+	assert(s && l);
+
+	mb_attempt_open_bracket(s, l);
+	mb_pop_string(s, l, &shapeFile);
+	mb_pop_string(s, l, &brushFile);
+	mb_pop_string(s, l, &paleteFile);
+	mb_pop_string(s, l, &assetFile);
+	mb_attempt_close_bracket(s, l);
+
+	compile_sprite_asset(shapeFile, brushFile, paleteFile, assetFile);
+
+	return result;
+}
+
+int age_api_load_sprites(mb_interpreter_t* s, void** l) {
+	int result = MB_FUNC_OK;
+	Str manifest = 0;
+	struct AssetLoading* loading = 0;
+
+	assert(s && l);
+
+	mb_attempt_open_bracket(s, l);
+	mb_pop_string(s, l, &manifest);
+	mb_attempt_close_bracket(s, l);
+
+	loading = load_sprite_assets_async(AGE_CVS, manifest, 0);
+	if(loading) {
+		wait_asset_loading(AGE_CVS, loading);
+		destroy_asset_loading(AGE_CVS, loading);
+	}
+
+	return result;
+}
+
+int age_api_load_sprites_async(mb_interpreter_t* s, void** l) {
+	int result = MB_FUNC_OK;
+	Str manifest = 0;
+	struct AssetLoading* loading = 0;
+
+	assert(s && l);
+
+	mb_attempt_open_bracket(s, l);
+	mb_pop_string(s, l, &manifest);
+	mb_attempt_close_bracket(s, l);
+
+	/* scripts keep no handle, the canvas frees the loading once it is published */
+	loading = load_sprite_assets_async(AGE_CVS, manifest, 0);
+	if(loading) {
+		detach_asset_loading(AGE_CVS, loading);
+	}
+
+	return result;
+}
+
 int age_api_destroy_sprite(mb_interpreter_t* s, void** l) {
 	int result = MB_FUNC_OK;
 	Str name = 0;
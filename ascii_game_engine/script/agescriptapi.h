@@ -109,6 +109,26 @@ AGE_INTERNAL int age_api_set_frame_rate(mb_interpreter_t* s, void** l);
  */
 AGE_INTERNAL int age_api_create_sprite(mb_interpreter_t* s, void** l);
 
+/**
+ * @brief my-basic api: create a sprite object from a compiled asset file
+ */
+AGE_INTERNAL int age_api_create_sprite_from_asset(mb_interpreter_t* s, void** l);
+
+/**
+ * @brief my-basic api: compile sprite data files into a binary asset file
+ */
+AGE_INTERNAL int age_api_compile_sprite_asset(mb_interpreter_t* s, void** l);
+
+/**
+ * @brief my-basic api: load sprites listed in a manifest file in parallel and wait for them
+ */
+AGE_INTERNAL int age_api_load_sprites(mb_interpreter_t* s, void** l);
+
+/**
+ * @brief my-basic api: load sprites listed in a manifest file in background
+ */
+AGE_INTERNAL int age_api_load_sprites_async(mb_interpreter_t* s, void** l);
+
 /**
  * @brief my-basic api: destroy a sprite in a canvas
  */
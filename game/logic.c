@@ -441,80 +441,79 @@ void on_removing_for_sprite_main_player(Ptr _handlerObj, Canvas* _cvs, Sprite* _
 void on_removing_for_sprite_board(Ptr _handlerObj, Canvas* _cvs, Sprite* _spr) {
 }
 
-void on_collide_for_sprite_main_player(Canvas* _cvs, Sprite* _spr, s32 _px, s32 _py) {
-	Pixel* pixelc = 0;
+static bl _is_pixel_owned_by(Canvas* _cvs, s32 _px, s32 _py, Sprite* _spr) {
+	PixelOwners* ownersc = 0;
+	s32 i = 0;
+
+	ownersc = get_pixel_owners(_cvs, _px, _py);
+	for(i = 0; ownersc && i < ownersc->owner_count; ++i) {
+		if(ownersc->owners[i].sprite == _spr) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+void on_contact_for_sprite_main_player(Canvas* _cvs, Sprite* _spr, const SpriteContact* _contact) {
+	const Rect* bounds = &_contact->contact.bounds;
 	PlayerUserdata* ud = 0;
 	Sprite* bd = 0;
-	s32 i = 0;
 	s32 k = 0;
 	s32 x = 0;
 	s32 y = 0;
 	s32 fx = 0;
 	s32 fy = 0;
-	s8 b = 0;
-	bl ob = FALSE;
-
-	assert(_px >= 0 && _px < CANVAS_WIDTH && _py >= 0 && _py < CANVAS_HEIGHT);
 
-	fx = _px - _spr->position.x;
-	fy = _py - _spr->position.y;
-	k = _spr->time_line.current_frame;
-	b = _spr->time_line.frames[k].tex[fx + fy * _spr->frame_size.w].brush;
+	assert(_cvs && _spr && _contact);
 
-	pixelc = &_cvs->pixels[_px + _py * _cvs->size.w];
 	ud = (PlayerUserdata*)(_spr->userdata.data);
 	if(ud->on_board[0]) {
 		return;
 	}
-	for(i = 0; i < pixelc->frame_count; ++i) {
-		bd = pixelc->owner_frames[i]->parent;
-		if(bd != _spr) {
-			if(b == game()->foot_brush) {
-				assert(strlen(_spr->name) + 1 < _countof(ud->on_board));
-				sprintf(ud->on_board, bd->name);
-				ob = TRUE;
-				if(_px + bd->position.x <= _spr->position.x) {
-					ud->collition_direction = -1;
-				} else if(_px >= _spr->position.x + _spr->frame_size.w) {
-					ud->collition_direction = 1;
-				} else {
-					ud->collition_direction = 0;
-				}
-				break;
+
+	/* standing on a board if any foot texel overlaps it */
+	bd = _contact->other;
+	k = _spr->time_line.current_frame;
+	for(y = bounds->y; y < bounds->y + bounds->h; ++y) {
+		for(x = bounds->x; x < bounds->x + bounds->w; ++x) {
+			fx = x - _spr->position.x;
+			fy = y - _spr->position.y;
+			if(_spr->time_line.frames[k].tex[fx + fy * _spr->frame_size.w].brush != game()->foot_brush) {
+				continue;
 			}
-		} else {
-			if(pixelc->frame_count == 1) {
-				ob = TRUE;
+			if(!_is_pixel_owned_by(_cvs, x, y, _spr) || !_is_pixel_owned_by(_cvs, x, y, bd)) {
+				continue;
+			}
+			assert(strlen(bd->name) + 1 < _countof(ud->on_board));
+			sprintf(ud->on_board, bd->name);
+			if(x + bd->position.x <= _spr->position.x) {
+				ud->collition_direction = -1;
+			} else if(x >= _spr->position.x + _spr->frame_size.w) {
+				ud->collition_direction = 1;
+			} else {
+				ud->collition_direction = 0;
 			}
+
+			return;
 		}
 	}
 
-	if(!ob) {
-		if(ud->collition_direction && _spr->direction && ud->collition_direction == _spr->direction) {
-			set_sprite_position(_cvs, _spr, _spr->last_frame_position.x, _spr->position.y);
-		}
+	/* otherwise hitting a board aside */
+	if(ud->collition_direction && _spr->direction && ud->collition_direction == _spr->direction) {
+		set_sprite_position(_cvs, _spr, _spr->last_frame_position.x, _spr->position.y);
 	}
 }
 
-void on_collide_for_sprite_board(Canvas* _cvs, Sprite* _spr, s32 _px, s32 _py) {
-	Pixel* pixelc = 0;
+void on_contact_for_sprite_board(Canvas* _cvs, Sprite* _spr, const SpriteContact* _contact) {
 	BoardUserdata* bu = 0;
-	Sprite* bd = 0;
-	s32 i = 0;
 
-	assert(_cvs && _spr);
+	assert(_cvs && _spr && _contact);
 
-	pixelc = &_cvs->pixels[_px + _py * _cvs->size.w];
-	for(i = 0; i < pixelc->frame_count; ++i) {
-		bd = pixelc->owner_frames[i]->parent;
-		if(bd != _spr) {
-			bu = (BoardUserdata*)(_spr->userdata.data);
-			if(_spr->time_line.pause) {
-				bu->collition = TRUE;
-				resume_sprite(_cvs, _spr);
-				break;
-			}
-		}
+	bu = (BoardUserdata*)(_spr->userdata.data);
+	if(_spr->time_line.pause) {
+		bu->collition = TRUE;
+		resume_sprite(_cvs, _spr);
 	}
 }
 
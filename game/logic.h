@@ -170,9 +170,9 @@ void on_removing_for_sprite_main_player(Ptr _handlerObj, Canvas* _cvs, Sprite* _
 
 void on_removing_for_sprite_board(Ptr _handlerObj, Canvas* _cvs, Sprite* _spr);
 
-void on_collide_for_sprite_main_player(Canvas* _cvs, Sprite* _spr, s32 _px, s32 _py);
+void on_contact_for_sprite_main_player(Canvas* _cvs, Sprite* _spr, const SpriteContact* _contact);
 
-void on_collide_for_sprite_board(Canvas* _cvs, Sprite* _spr, s32 _px, s32 _py);
+void on_contact_for_sprite_board(Canvas* _cvs, Sprite* _spr, const SpriteContact* _contact);
 
 void on_update_for_sprite_main_player(Canvas* _cvs, Sprite* _spr, s32 _elapsedTime);
 
@@ -26,15 +26,17 @@
 #include "renderer.h"
 #include "game.h"
 
-void main_canvas_prev_render(Canvas* _cvs, s32 _elapsedTime) {
+void main_canvas_fill_background(Canvas* _cvs) {
 	s32 i = 0;
-	static Font f = { 1 };
 
 	for(i = 0; i < GAME_AREA_HEIGHT; ++i) {
-		put_char(_cvs, &f, GAME_AREA_LEFT, i, '#');
-		put_char(_cvs, &f, GAME_AREA_RIGHT, i, '#');
+		set_background_pixel(_cvs, GAME_AREA_LEFT, i, '#', get_mapped_color(1));
+		set_background_pixel(_cvs, GAME_AREA_RIGHT, i, '#', get_mapped_color(1));
 	}
 }
 
+void main_canvas_prev_render(Canvas* _cvs, s32 _elapsedTime) {
+}
+
 void main_canvas_post_render(Canvas* _cvs, s32 _elapsedTime) {
 }
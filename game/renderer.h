@@ -35,6 +35,8 @@
 #define GAME_AREA_TOP 0
 #define GAME_AREA_BOTTOM (GAME_AREA_TOP + GAME_AREA_HEIGHT)
 
+void main_canvas_fill_background(Canvas* _cvs);
+
 void main_canvas_prev_render(Canvas* _cvs, s32 _elapsedTime);
 
 void main_canvas_post_render(Canvas* _cvs, s32 _elapsedTime);
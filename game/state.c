@@ -29,23 +29,20 @@
 #include "game.h"
 
 static void _draw_logo(s32 _time) {
-	s32 i = 0;
-	s32 j = 0;
+	static s32 __l = 0;
 	s32 __w = game()->main->frame_size.w;
 	s32 __h = game()->main->frame_size.h;
 	f32 __p = (_time % 3000) / 1000.0f;
 	s32 __c = __w + __h;
 	__c = (s32)(__c * __p);
-	for(j = 0; j < __h; ++j) {
-		for(i = 0; i < __w; ++i) {
-			set_sprite_pixel_color(AGE_CVS, game()->main, 0, i, j, get_mapped_color(8));
-		}
-	}
-	j = 0;
-	for(i = __c; i >= 0; --i) {
-		set_sprite_pixel_color(AGE_CVS, game()->main, 0, i, j, get_mapped_color(15));
-		++j;
+	/* a highlighted diagonal sweeps over the logo, gradient index of a texel is x + y */
+	if(!game()->main->tint.gradient) {
+		set_sprite_tint(AGE_CVS, game()->main, get_mapped_color(8));
+		set_sprite_gradient(AGE_CVS, game()->main, 1, 1, __w + __h);
 	}
+	set_sprite_gradient_color(AGE_CVS, game()->main, __l, NO_TINT_COLOR);
+	set_sprite_gradient_color(AGE_CVS, game()->main, __c, get_mapped_color(15));
+	__l = __c;
 }
 
 s32 state_show_splash(Ptr _obj, const Str _name, s32 _elapsedTime, u32 _lparam, u32 _wparam, Ptr _extra) {
@@ -60,6 +57,7 @@ s32 state_show_splash(Ptr _obj, const Str _name, s32 _elapsedTime, u32 _lparam,
 	static Font f;
 
 	s32 result = 0;
+	bl done = FALSE;
 	static s32 state = _S_DEFAULT;
 	static s32 time = 0;
 	static s32 ci = 0;
@@ -114,16 +112,21 @@ s32 state_show_splash(Ptr _obj, const Str _name, s32 _elapsedTime, u32 _lparam,
 				if(time >= _PHASE_TIME * 5) {
 					state = _S_DEFAULT;
 					set_canvas_controller(AGE_CVS, state_show_logo);
+					done = TRUE;
 				}
 			}
 			break;
 	}
 
-	f.color = get_mapped_color(_COLORS[ci]);
-	draw_string(AGE_CVS, &f, 31, 11, _SPLASH);
-	if(state != _S_TATE_4 && state != _S_DEFAULT) {
-		f.color = get_mapped_color(12);
-		draw_string(AGE_CVS, &f, 31 + 6, 11, "'");
+	if(done) {
+		clear_text(AGE_CVS);
+	} else {
+		f.color = get_mapped_color(_COLORS[ci]);
+		draw_string(AGE_CVS, &f, 31, 11, _SPLASH);
+		if(state != _S_TATE_4 && state != _S_DEFAULT) {
+			f.color = get_mapped_color(12);
+			draw_string(AGE_CVS, &f, 31 + 6, 11, "'");
+		}
 	}
 
 	return result;
@@ -229,6 +232,7 @@ s32 state_show_logo(Ptr _obj, const Str _name, s32 _elapsedTime, u32 _lparam, u3
 							AGE_CVS->prev_render = main_canvas_prev_render;
 							AGE_CVS->post_render = main_canvas_post_render;
 							clear_screen(AGE_CVS);
+							main_canvas_fill_background(AGE_CVS);
 						} else if(__m == 1) { /* highscore */
 							destroy_sprite(AGE_CVS, game()->main);
 							destroy_sprite(AGE_CVS, game()->subsidiary);
@@ -379,13 +383,13 @@ s32 state_main(Ptr _obj, const Str _name, s32 _elapsedTime, u32 _lparam, u32 _wp
 			register_message_proc(&game()->main->message_map, MSG_JUMP, on_msg_proc_for_sprite_main_player_jump);
 			set_sprite_physics_mode(AGE_CVS, game()->main, PHYSICS_MODE_OBSTACLE | PHYSICS_MODE_CHECKER);
 			game()->main->object_removed = on_removing_for_sprite_main_player;
-			game()->main->collided = on_collide_for_sprite_main_player;
+			game()->main->contacted = on_contact_for_sprite_main_player;
 			game()->main->update = 0;
 			game()->main->userdata.data = create_player_userdata();
 			game()->main->userdata.destroy = destroy_player_userdata;
 			((PlayerUserdata*)(game()->main->userdata.data))->fall_time = DEFAULT_FALL_TIME;
 			game()->board_template->object_removed = on_removing_for_sprite_board;
-			game()->board_template->collided = on_collide_for_sprite_board;
+			game()->board_template->contacted = on_contact_for_sprite_board;
 			game()->board_template->update = on_update_for_sprite_board;
 			game()->set_score_board_visible(TRUE);
 			game()->set_score_board_value(0);